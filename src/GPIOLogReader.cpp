@@ -18,7 +18,8 @@
  */
 #include "GPIOLogReader.h"
 
-GPIOLogReader::GPIOLogReader(const std::string & fileName)
+GPIOLogReader::GPIOLogReader(const std::string & fileName):
+	m_time()
 {
 	m_stream.open(fileName, std::ios_base::in | std::ios_base::binary);
 	if (!m_stream.good())
@@ -39,6 +40,7 @@ std::optional<rts::Duration> GPIOLogReader::get()
 
 	rts::Duration duration(*d, m_state);
 	m_state = !m_state;
+	m_time += *d;
 
 	return duration;
 }
@@ -35,12 +35,19 @@ public:
 
 	std::optional<rts::Duration> get();
 
+	// the end of the last Duration returned by get(), counted from the start of the log
+	std::optional<rts::Clock::time_point> getLastTransitionTime() const
+	{
+		return m_time;
+	}
+
 public:
 	std::optional<uint64_t> readUint64();
 	std::optional<rts::Clock::duration> readDuration();
 
 	std::ifstream m_stream;
 	bool m_state;
+	rts::Clock::time_point m_time;
 };
 
 #endif // GPIO_LOG_READER_H
@@ -19,8 +19,6 @@
 #include <memory>
 #include <iostream>
 #include <vector>
-#include <type_traits>
-#include <limits>
 
 #include "rts/SomfyFrame.h"
 #include "rts/IFrameTransmitter.h"
@@ -30,6 +28,7 @@
 #include <boost/any.hpp>
 
 #include "GPIOLogWriter.h"
+#include "SomfyFrameOptions.h"
 
 using namespace std::literals;
 
@@ -69,63 +68,6 @@ namespace
 		const rts::SomfyFrame frame(key, ctrl, rollingCode, address);
 		transmitter->send(frame, nRepeatFrames);
 	}
-
-	const std::map<std::string, rts::SomfyFrame::Action> ACTION_NAMES =
-	{
-		{ "up", rts::SomfyFrame::Action::up },
-		{ "down", rts::SomfyFrame::Action::down },
-		{ "my", rts::SomfyFrame::Action::my },
-		{ "my+down", rts::SomfyFrame::Action::my_down },
-		{ "up+down", rts::SomfyFrame::Action::up_down },
-		{ "flag", rts::SomfyFrame::Action::flag },
-		{ "sun+flag", rts::SomfyFrame::Action::sun_flag },
-		{ "prog", rts::SomfyFrame::Action::prog }
-	};
-}
-
-// defined in namespace rts because of Argument-dependent lookup
-namespace rts
-{
-	std::istream & operator>>(std::istream & in, SomfyFrame::Action & action)
-	{
-		std::string token;
-		in >> token;
-
-		auto it = ACTION_NAMES.find(token);
-		if (it != ACTION_NAMES.end())
-			action = it->second;
-		else
-			in.setstate(std::ios_base::failbit);
-
-		return in;
-	}
-}
-
-// a simple wrapper around an integral type used solely to let boost::program_options
-// parse the input value ourselves - to enable hex input (0x...)
-template<typename T>
-struct Number
-{
-	static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "T must be an unsigned integral type!");
-	T value;
-};
-
-template<typename T>
-std::istream & operator>>(std::istream & in, Number<T> & n)
-{
-	std::string token;
-	in >> token;
-
-	static_assert(std::numeric_limits<T>::max() <= std::numeric_limits<unsigned long long>::max(),
-		"T must fit in unsigned long long");
-
-	size_t numConverted = 0;
-	n.value = static_cast<T>(std::stoull(token, &numConverted, 0));
-
-	if (numConverted != token.size())
-		in.setstate(std::ios_base::failbit);
-
-	return in;
 }
 
 int main(int argc, char * argv[])
@@ -140,13 +82,7 @@ int main(int argc, char * argv[])
 		Number<uint32_t> nRepeatFrames = { DEFAULT_REPEAT_FRAMES };
 		std::string logFile;
 
-		std::string allActions;
-		for (const auto & actionItem : ACTION_NAMES)
-		{
-			if (!allActions.empty())
-				allActions += ", ";
-			allActions += actionItem.first;
-		}
+		const std::string allActions = getAllActionNames();
 
 		boost::program_options::options_description argDescription("Available options");
 		argDescription.add_options()
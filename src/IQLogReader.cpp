@@ -18,44 +18,137 @@
  */
 #include "IQLogReader.h"
 
-IQLogReader::IQLogReader(const std::string & fileName)
+#include <stdexcept>
+#include <system_error>
+#include <algorithm>
+#include <cstdint>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	/*
+	 * Size of blocks handed out to the decoder (in bytes). Larger blocks mean
+	 * less overhead, but the decoder needs a buffer for the demodulated bits
+	 * of a whole block.
+	 */
+	constexpr size_t BLOCK_SIZE = 1024*1024;
+}
+
+IQLogReader::IQLogReader(const std::string & fileName):
+	m_fd(-1),
+	m_mapping(nullptr),
+	m_mappingSize(0),
+	m_offset(0)
+{
+	if (fileName == "-")
+		m_fd = STDIN_FILENO;
+	else
+	{
+		m_fd = open(fileName.c_str(), O_RDONLY);
+		if (m_fd < 0)
+			throw std::system_error(errno, std::generic_category(), std::string("Can't read ") + fileName);
+	}
+
+	if (!map())
+	{
+		m_buffer.resize(BLOCK_SIZE);
+		posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+}
+
+IQLogReader::~IQLogReader()
+{
+	if (m_mapping)
+		munmap(const_cast<uint8_t*>(m_mapping), m_mappingSize);
+
+	if (m_fd != STDIN_FILENO)
+		close(m_fd);
+}
+
+std::optional<rts::IQBlock> IQLogReader::getBlock()
 {
-	m_stream.open(fileName, std::ios_base::in | std::ios_base::binary);
-	if (!m_stream.good())
-		throw std::runtime_error(std::string("Can't read ") + fileName);
+	return m_mapping ? getMappedBlock() : readBlock();
 }
 
-std::optional<std::complex<float>> IQLogReader::getNextSample()
+std::optional<rts::IQBlock> IQLogReader::getAllSamples() const
 {
-	const std::optional<float> i = getNextFloat();
-	if (!i)
+	if (!m_mapping)
 		return std::nullopt;
 
-	const std::optional<float> q = getNextFloat();
-	if (!q)
+	if (m_mappingSize % 2 != 0)
 		throw std::runtime_error("unexpected end of input file");
 
-	return std::complex<float>(*i, *q);
+	return rts::IQBlock{m_mapping, m_mappingSize / 2};
 }
 
-std::optional<float> IQLogReader::getNextFloat()
+bool IQLogReader::map()
 {
-	std::optional<uint8_t> b = readUint8();
-	if (!b)
+	struct stat st;
+	if (fstat(m_fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0)
+		return false;
+
+	// the size might not fit in size_t (a 32-bit system and a big file)
+	if (static_cast<uintmax_t>(st.st_size) > SIZE_MAX)
+		return false;
+
+	const size_t size = static_cast<size_t>(st.st_size);
+	void * mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (mapping == MAP_FAILED)
+		return false; // e.g. not enough address space, use read() instead
+
+	// the whole file is read once from the beginning to the end
+	madvise(mapping, size, MADV_SEQUENTIAL);
+
+	m_mapping = static_cast<const uint8_t*>(mapping);
+	m_mappingSize = size;
+	return true;
+}
+
+std::optional<rts::IQBlock> IQLogReader::getMappedBlock()
+{
+	if (m_offset == m_mappingSize)
 		return std::nullopt;
 
-	return static_cast<float>(*b)/128.0f - 1.0f;
+	const size_t size = std::min(BLOCK_SIZE, m_mappingSize - m_offset);
+	if (size % 2 != 0)
+		throw std::runtime_error("unexpected end of input file");
+
+	const rts::IQBlock block{m_mapping + m_offset, size / 2};
+	m_offset += size;
+	return block;
 }
 
-std::optional<uint8_t> IQLogReader::readUint8()
+std::optional<rts::IQBlock> IQLogReader::readBlock()
 {
-	uint8_t value;
-	m_stream.read(reinterpret_cast<char*>(&value), sizeof(value));
-	if (m_stream.eof())
+	// read() on a pipe can return less than requested, so keep reading
+	// until the buffer is full or there is no more data
+	size_t size = 0;
+	while (size < m_buffer.size())
+	{
+		const ssize_t r = read(m_fd, m_buffer.data() + size, m_buffer.size() - size);
+		if (r < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(errno, std::generic_category(), "can't read input file");
+		}
+
+		if (r == 0)
+			break; // end of file
+
+		size += r;
+	}
+
+	if (size == 0)
 		return std::nullopt;
 
-	if (m_stream.bad() || m_stream.gcount() != sizeof(value))
-		throw std::runtime_error("can't read input file");
+	if (size % 2 != 0)
+		throw std::runtime_error("unexpected end of input file");
 
-	return value;
+	return rts::IQBlock{m_buffer.data(), size / 2};
 }
@@ -20,23 +20,51 @@
 #define IQ_LOG_READER_H
 
 #include <string>
-#include <fstream>
+#include <cstddef>
 #include <cstdint>
-#include <complex>
+#include <vector>
 #include <optional>
 
+#include "rts/backend/rtlsdr/IQBlock.h"
+
+/**
+ * @brief Reads a raw rtl-sdr IQ log.
+ *
+ * Regular files are mapped into memory and handed out to the decoder block
+ * by block without any copying. Anything that can't be mapped (e.g. a pipe)
+ * is read in large blocks using read(). The file name "-" means stdin.
+ */
 class IQLogReader
 {
 public:
 	IQLogReader(const std::string & fileName);
+	~IQLogReader();
 
-	std::optional<std::complex<float>> getNextSample();
+	IQLogReader(const IQLogReader &) = delete;
+	IQLogReader & operator=(const IQLogReader &) = delete;
 
-public:
-	std::optional<float> getNextFloat();
-	std::optional<uint8_t> readUint8();
+	std::optional<rts::IQBlock> getBlock();
+
+	/**
+	 * All the samples if the file is mapped into memory, std::nullopt
+	 * otherwise. This doesn't affect getBlock().
+	 */
+	std::optional<rts::IQBlock> getAllSamples() const;
+
+private:
+	bool map();
+	std::optional<rts::IQBlock> getMappedBlock();
+	std::optional<rts::IQBlock> readBlock();
+
+	int m_fd;
+
+	// used if the file is mapped
+	const uint8_t * m_mapping;
+	size_t m_mappingSize;
+	size_t m_offset;
 
-	std::ifstream m_stream;
+	// used otherwise
+	std::vector<uint8_t> m_buffer;
 };
 
 #endif // IQ_LOG_READER_H
@@ -21,12 +21,21 @@
 	#include "rts/backend/rtlsdr/RTLSDRDevice.h"
 	#include "rts/backend/rtlsdr/RTLSDRBufferReader.h"
 	#include "rts/backend/rtlsdr/RTLSDRIQSource.h"
+	#include "rts/LogFileWriter.h"
 #endif // HAVE_RTLSDR
 
 #include "IQLogReader.h"
 #include "rts/DurationTracker.h"
 #include "rts/SomfyDecoder.h"
+#include "rts/SomfyFramePrinter.h"
+#include "rts/ThreadedSource.h"
+#include "rts/ThreadPrio.h"
 #include "rts/backend/rtlsdr/OOKDecoder.h"
+#include "rts/backend/rtlsdr/CICDecimator.h"
+#include "rts/backend/rtlsdr/ParallelIQDecoder.h"
+#include "rts/backend/rtlsdr/OOKDemodulator.h"
+#include "rts/backend/rtlsdr/FixedPointOOKDemodulator.h"
+#include "rts/backend/rtlsdr/IQFlightRecorder.h"
 
 #include <iostream>
 #include <stdexcept>
@@ -35,21 +44,120 @@
 #include <vector>
 #include <thread>
 #include <optional>
+#include <chrono>
 
 #include <boost/program_options.hpp>
 
 namespace
 {
+	enum class DemodulatorType
+	{
+		simd,
+		lut,
+		fixed
+	};
+
+	DemodulatorType parseDemodulatorType(const std::string & name)
+	{
+		if (name == "simd")
+			return DemodulatorType::simd;
+		else if (name == "lut")
+			return DemodulatorType::lut;
+		else if (name == "fixed")
+			return DemodulatorType::fixed;
+		else
+			throw boost::program_options::invalid_option_value(name);
+	}
+
 	constexpr uint32_t DEFAULT_RTLSDR_DEVICE_INDEX = 0;
+	const std::string DEFAULT_DEMODULATOR = "simd";
 	constexpr double DEFAULT_TOLERANCE = 0.1;
+	constexpr size_t DEFAULT_BUFFER_SIZE = 256*1024;
+	constexpr size_t DEFAULT_BUFFER_COUNT = 5;
+	constexpr size_t DEFAULT_DECIMATION = 1;
+	constexpr size_t MAX_DECIMATION = 65; // 40 kS/s: a symbol (645 us) is still ~26 samples
+	constexpr unsigned DEFAULT_CAPTURE_BEFORE = 500; // ms
+	constexpr unsigned DEFAULT_CAPTURE_AFTER = 500; // ms
 	constexpr uint32_t RTLSDR_SAMPLE_RATE = 2600000; // 2.6 MHz
 #ifdef HAVE_RTLSDR
 	constexpr uint32_t RTLSDR_FREQUENCY = 433420000; // 433.42 MHz
 #endif
 
+	// how to decode the samples, for both the rtl-sdr device and an IQ log
+	struct DecodingOptions
+	{
+		double tolerance;
+		size_t decimation;
+		DemodulatorType demodulatorType;
+		bool pipelined;
+
+		// decode an IQ log in chunks using this many threads (0 = one per CPU)
+		std::optional<unsigned> jobs;
+
+		// save the samples around the frames into files with this prefix (see IQFlightRecorder)
+		std::string capturePrefix;
+		rts::Clock::duration captureBefore;
+		rts::Clock::duration captureAfter;
+	};
+
+	/*
+	 * In the pipelined mode, each stage runs in its own thread: reading the
+	 * device (RTLSDRIQSource), demodulation (OOKDecoder) and decoding of the
+	 * frames (DurationTracker and SomfyDecoder, in the main thread). If there
+	 * are enough CPUs, the stages are pinned to CPUs 1, 2 and 3. CPU 0 is left
+	 * alone, it handles the interrupts (including USB) on a Raspberry Pi.
+	 */
+	enum class PipelineStage
+	{
+		reading,
+		demodulation,
+		frameDecoding
+	};
+
+	constexpr unsigned PIPELINE_STAGES = 3;
+	constexpr size_t TRANSITION_QUEUE_CAPACITY = 4096;
+
+	std::optional<unsigned> getPipelineStageCPU(PipelineStage stage)
+	{
+		if (std::thread::hardware_concurrency() <= PIPELINE_STAGES)
+			return std::nullopt;
+
+		return static_cast<unsigned>(stage) + 1;
+	}
+
+	template<typename TransitionSource, typename Recorder>
+	void runSomfyDecoder(TransitionSource & transitionSource, double tolerance, Recorder & recorder)
+	{
+		typedef rts::DurationTracker<TransitionSource> Tracker;
+		typedef rts::FlightRecorderTrigger<Recorder> Listener;
+
+		Tracker durationTracker(transitionSource);
+		rts::SomfyDecoder<Tracker, Listener> decoder(durationTracker, tolerance, Listener(recorder));
+
+		decoder.run();
+	}
+
+	template<typename TransitionSource, typename Recorder>
+	void decodeTransitions(TransitionSource & transitionSource, const DecodingOptions & options, Recorder & recorder)
+	{
+		if (options.pipelined)
+		{
+			rts::ThreadedSource<TransitionSource, rts::Transition> transitions(transitionSource, TRANSITION_QUEUE_CAPACITY);
+			transitions.start(getPipelineStageCPU(PipelineStage::demodulation));
+
+			if (const std::optional<unsigned> cpu = getPipelineStageCPU(PipelineStage::frameDecoding))
+				rts::setCurrentThreadAffinity(*cpu);
+
+			runSomfyDecoder(transitions, options.tolerance, recorder);
+		}
+		else
+			runSomfyDecoder(transitionSource, options.tolerance, recorder);
+	}
+
 #ifdef HAVE_RTLSDR
-	void decodeSdrDev(uint32_t deviceIndex, double tolerance, const size_t bufferSize, const size_t bufferCount,
-		const std::string & logName)
+	template<typename Demodulator>
+	void decodeSdrDev(uint32_t deviceIndex, const DecodingOptions & options, const size_t bufferSize, const size_t bufferCount,
+		rts::RTLSDRIQSource::ReadMode readMode, const std::string & logName, const rts::LogFileOptions & logOptions)
 	{
 		rts::RTLSDRDevice rtlSDRDevice(deviceIndex);
 
@@ -63,12 +171,13 @@ namespace
 			rtlSDRDevice.setTunerGain(*manualGain);
 		}
 
-		rts::RTLSDRIQSource rtlSDRIQSource(rtlSDRDevice, bufferSize, bufferCount, logName);
-		rts::OOKDecoder<rts::RTLSDRIQSource> ookDecoder(rtlSDRIQSource, RTLSDR_SAMPLE_RATE);
-		rts::DurationTracker<rts::OOKDecoder<rts::RTLSDRIQSource>> durationTracker(ookDecoder);
-		rts::SomfyDecoder decoder(durationTracker, tolerance);
+		rts::RTLSDRIQSource rtlSDRIQSource(rtlSDRDevice, bufferSize, bufferCount, logName, readMode, logOptions);
+		typedef rts::IQFlightRecorder<rts::RTLSDRIQSource> Recorder;
+		Recorder recorder(rtlSDRIQSource, RTLSDR_SAMPLE_RATE, options.capturePrefix, options.captureBefore, options.captureAfter);
+		rts::CICDecimator<Recorder> decimator(recorder, options.decimation);
+		rts::OOKDecoder<rts::CICDecimator<Recorder>, Demodulator> ookDecoder(decimator, RTLSDR_SAMPLE_RATE / options.decimation);
 
-		rtlSDRIQSource.start();
+		rtlSDRIQSource.start(options.pipelined ? getPipelineStageCPU(PipelineStage::reading) : std::nullopt);
 
 		installSigIntHandler();
 
@@ -77,19 +186,67 @@ namespace
 			rtlSDRIQSource.stop();
 		});
 
-		decoder.run();
+		decodeTransitions(ookDecoder, options, recorder);
 		stopThread.join();
 	}
+
+	void decodeSdrDev(uint32_t deviceIndex, const DecodingOptions & options, const size_t bufferSize, const size_t bufferCount,
+		rts::RTLSDRIQSource::ReadMode readMode, const std::string & logName, const rts::LogFileOptions & logOptions)
+	{
+		switch (options.demodulatorType)
+		{
+		case DemodulatorType::simd:
+			decodeSdrDev<rts::OOKDemodulator<rts::SIMDMagnitude>>(deviceIndex, options, bufferSize, bufferCount, readMode, logName, logOptions);
+			break;
+		case DemodulatorType::lut:
+			decodeSdrDev<rts::OOKDemodulator<rts::LUTMagnitude>>(deviceIndex, options, bufferSize, bufferCount, readMode, logName, logOptions);
+			break;
+		case DemodulatorType::fixed:
+			decodeSdrDev<rts::FixedPointOOKDemodulator>(deviceIndex, options, bufferSize, bufferCount, readMode, logName, logOptions);
+			break;
+		}
+	}
 #endif // HAVE_RTLSDR
 
-	void decodeIqLog(const std::string & iqLogFileName, double tolerance)
+	template<typename Demodulator>
+	void decodeIqLog(const std::string & iqLogFileName, const DecodingOptions & options)
 	{
 		IQLogReader iqLogReader(iqLogFileName);
-		rts::OOKDecoder<IQLogReader> ookDecoder(iqLogReader, RTLSDR_SAMPLE_RATE);
-		rts::DurationTracker<rts::OOKDecoder<IQLogReader>> durationTracker(ookDecoder);
-		rts::SomfyDecoder decoder(durationTracker, tolerance);
 
-		decoder.run();
+		if (options.jobs)
+		{
+			const std::optional<rts::IQBlock> samples = iqLogReader.getAllSamples();
+			if (!samples)
+				throw std::runtime_error("-j (--jobs) requires an IQ log that can be mapped into memory (a regular file)");
+
+			rts::ParallelIQDecoder<Demodulator> decoder(*samples, RTLSDR_SAMPLE_RATE, options.decimation, options.tolerance, *options.jobs);
+			rts::SomfyFramePrinter printer;
+			decoder.run(printer);
+			return;
+		}
+
+		typedef rts::IQFlightRecorder<IQLogReader> Recorder;
+		Recorder recorder(iqLogReader, RTLSDR_SAMPLE_RATE, options.capturePrefix, options.captureBefore, options.captureAfter);
+		rts::CICDecimator<Recorder> decimator(recorder, options.decimation);
+		rts::OOKDecoder<rts::CICDecimator<Recorder>, Demodulator> ookDecoder(decimator, RTLSDR_SAMPLE_RATE / options.decimation);
+
+		decodeTransitions(ookDecoder, options, recorder);
+	}
+
+	void decodeIqLog(const std::string & iqLogFileName, const DecodingOptions & options)
+	{
+		switch (options.demodulatorType)
+		{
+		case DemodulatorType::simd:
+			decodeIqLog<rts::OOKDemodulator<rts::SIMDMagnitude>>(iqLogFileName, options);
+			break;
+		case DemodulatorType::lut:
+			decodeIqLog<rts::OOKDemodulator<rts::LUTMagnitude>>(iqLogFileName, options);
+			break;
+		case DemodulatorType::fixed:
+			decodeIqLog<rts::FixedPointOOKDemodulator>(iqLogFileName, options);
+			break;
+		}
 	}
 }
 
@@ -100,25 +257,55 @@ int main(int argc, char * argv[])
 		uint32_t deviceIndex = DEFAULT_RTLSDR_DEVICE_INDEX;
 		std::string inputFileName;
 		double tolerance = DEFAULT_TOLERANCE;
-#ifdef HAVE_RTLSDR
-		// TODO: make these into command line options
-		constexpr size_t bufferSize = 256*1024;
-		constexpr size_t bufferCount = 5;
-		std::string logName; // TODO
-#endif
+		std::string demodulator = DEFAULT_DEMODULATOR;
+		size_t decimation = DEFAULT_DECIMATION;
+		unsigned jobs = 0;
+		size_t bufferSize = DEFAULT_BUFFER_SIZE;
+		size_t bufferCount = DEFAULT_BUFFER_COUNT;
+		std::string logName;
+		unsigned logPreallocate = 0;
+		std::string capturePrefix;
+		unsigned captureBefore = DEFAULT_CAPTURE_BEFORE;
+		unsigned captureAfter = DEFAULT_CAPTURE_AFTER;
 
 		boost::program_options::options_description argDescription("Available options");
 		argDescription.add_options()
 			("device-index,d", boost::program_options::value(&deviceIndex),
 				(std::string("Index of the RTL SDR device to read samples from. Default: ") + std::to_string(DEFAULT_RTLSDR_DEVICE_INDEX)).c_str())
 			("file,f", boost::program_options::value(&inputFileName),
-				"Source file name. (IQ format sampled at 2.6 MHz.)"
+				"Source file name. (IQ format sampled at 2.6 MHz.) Use - to read from stdin."
 #ifndef HAVE_RTLSDR
 				" OPTION NOT AVAILABLE IN THIS BUILD (executable has been built without librtlsdr)!"
 #endif
 			)
+			("async,a",
+				"Let the RTL SDR device stream samples asynchronously (keep buffer-count USB transfers queued) instead of reading them one buffer at a time.")
+			("buffer-size,b", boost::program_options::value(&bufferSize),
+				(std::string("Size of the buffers (in bytes) used to read samples from the RTL SDR device. Must be a non-zero multiple of 512. Default: ") + std::to_string(DEFAULT_BUFFER_SIZE)).c_str())
+			("buffer-count,n", boost::program_options::value(&bufferCount),
+				(std::string("Number of the buffers used to read samples from the RTL SDR device. Default: ") + std::to_string(DEFAULT_BUFFER_COUNT)).c_str())
+			("log,l", boost::program_options::value(&logName),
+				"Write the raw samples read from the RTL SDR device into this file (in a separate thread). The file can be decoded later by -f.")
+			("log-direct",
+				"Write the log (-l) bypassing the page cache (O_DIRECT), if the file system supports it.")
+			("log-preallocate", boost::program_options::value(&logPreallocate),
+				"Preallocate this many MiB for the log (-l). The unused space is released at the end.")
+			("capture,c", boost::program_options::value(&capturePrefix),
+				"Keep the last few seconds of samples in memory and save the samples around each detected frame (or decoding error) into a file named PREFIX-N.iq. The files can be decoded by -f.")
+			("capture-before", boost::program_options::value(&captureBefore),
+				(std::string("How much to save before a frame (-c), in ms. Default: ") + std::to_string(DEFAULT_CAPTURE_BEFORE)).c_str())
+			("capture-after", boost::program_options::value(&captureAfter),
+				(std::string("How much to save after a frame (-c), in ms. Default: ") + std::to_string(DEFAULT_CAPTURE_AFTER)).c_str())
 			("tolerance,t", boost::program_options::value(&tolerance),
 				(std::string("Tolerance in measured timing. Default: ") + std::to_string(DEFAULT_TOLERANCE)).c_str())
+			("demodulator,m", boost::program_options::value(&demodulator),
+				(std::string("How to demodulate IQ samples: simd (calculate the magnitude), lut (use a lookup table) or fixed (integer arithmetic only, for CPUs without a fast FPU). Default: ") + DEFAULT_DEMODULATOR).c_str())
+			("decimation,x", boost::program_options::value(&decimation),
+				(std::string("Decimate the samples by this factor before demodulating them, e.g. 13 to demodulate at 200 kS/s. It has to divide the sample rate (2.6 MS/s). Default: ") + std::to_string(DEFAULT_DECIMATION)).c_str())
+			("pipeline,p",
+				"Run the reading of samples, the demodulation and the decoding of frames in separate threads (pinned to separate CPUs if there are at least 4).")
+			("jobs,j", boost::program_options::value(&jobs),
+				"Decode the IQ log (-f) in chunks using this many threads (0 = one per CPU). The output is the same as without this option.")
 			("help,h", "print this help")
 		;
 
@@ -133,6 +320,28 @@ int main(int argc, char * argv[])
 
 		boost::program_options::notify(variablesMap);
 
+		const DemodulatorType demodulatorType = parseDemodulatorType(demodulator);
+
+		if (bufferSize == 0 || bufferSize % 512 != 0)
+			throw boost::program_options::invalid_option_value(std::to_string(bufferSize));
+
+		// the decimated rate has to be exact, the time stamps are derived from it
+		if (decimation == 0 || decimation > MAX_DECIMATION || RTLSDR_SAMPLE_RATE % decimation != 0)
+			throw boost::program_options::invalid_option_value(std::to_string(decimation));
+
+		if (bufferCount == 0)
+			throw boost::program_options::invalid_option_value(std::to_string(bufferCount));
+
+		const DecodingOptions decodingOptions{tolerance, decimation, demodulatorType, variablesMap.count("pipeline") > 0,
+			variablesMap.count("jobs") ? std::optional<unsigned>(jobs) : std::nullopt,
+			capturePrefix, std::chrono::milliseconds(captureBefore), std::chrono::milliseconds(captureAfter)};
+
+		if (decodingOptions.jobs && !capturePrefix.empty())
+		{
+			std::cerr << "-c (--capture) can't be combined with -j (--jobs)." << std::endl;
+			return 1;
+		}
+
 		if (variablesMap.count("device-index") && variablesMap.count("file"))
 		{
 			std::cerr << "Only one of -d (--device-index) and -f (--file) can be specified." << std::endl;
@@ -149,12 +358,17 @@ int main(int argc, char * argv[])
 		}
 		else if (variablesMap.count("file"))
 		{
-			decodeIqLog(inputFileName, tolerance);
+			decodeIqLog(inputFileName, decodingOptions);
 		}
 		else
 		{
 #ifdef HAVE_RTLSDR
-			decodeSdrDev(deviceIndex, tolerance, bufferSize, bufferCount, logName);
+			const rts::RTLSDRIQSource::ReadMode readMode = variablesMap.count("async") ?
+				rts::RTLSDRIQSource::ReadMode::async : rts::RTLSDRIQSource::ReadMode::sync;
+			rts::LogFileOptions logOptions;
+			logOptions.directIO = variablesMap.count("log-direct") > 0;
+			logOptions.preallocate = static_cast<uint64_t>(logPreallocate) * 1024 * 1024;
+			decodeSdrDev(deviceIndex, decodingOptions, bufferSize, bufferCount, readMode, logName, logOptions);
 #else
 			std::cerr << "This executable has been built without librtlsdr so reading from a rtlsdr device is not possible." << std::endl;
 #endif
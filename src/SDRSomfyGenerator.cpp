@@ -0,0 +1,181 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "rts/DurationBuffer.h"
+#include "rts/LogFileWriter.h"
+#include "rts/SomfyFrame.h"
+#include "rts/SomfyFrameEncoder.h"
+#include "rts/backend/rtlsdr/IQModulator.h"
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+
+#include <boost/program_options.hpp>
+
+#include "SomfyFrameOptions.h"
+
+/*
+ * Generate synthetic IQ logs of Somfy transmissions. They can be decoded by
+ * sdr-somfy-decoder -f, e.g. for testing and benchmarking without real
+ * captures.
+ */
+
+namespace
+{
+	constexpr size_t DEFAULT_SAMPLE_RATE = 2600000;
+	constexpr size_t DEFAULT_REPEAT_FRAMES = 1;
+	constexpr size_t DEFAULT_COUNT = 1;
+	constexpr unsigned DEFAULT_GAP = 500; // ms
+	constexpr unsigned DEFAULT_JITTER = 0; // µs
+
+	struct TransmissionOptions
+	{
+		rts::SomfyFrame frame;
+		size_t repeatFrameCount;
+		size_t count;
+		std::chrono::milliseconds gap;
+	};
+
+	// count transmissions of the frame, the rolling code increases by one in each
+	std::vector<rts::Duration> makeTransmissions(const TransmissionOptions & options)
+	{
+		rts::DurationBuffer buffer;
+		rts::SomfyFrame frame = options.frame;
+		for (size_t i = 0; i < options.count; i++)
+		{
+			buffer << rts::Duration(options.gap, false);
+			rts::SomfyFrameEncoder::appendTransmission(buffer, frame, options.repeatFrameCount);
+			frame.setRollingCode(frame.getRollingCode() + 1);
+		}
+		buffer << rts::Duration(options.gap, false);
+
+		return buffer.get();
+	}
+
+	void generate(const std::string & outputFileName, const TransmissionOptions & transmissionOptions,
+		size_t sampleRate, const rts::IQModulatorOptions & modulatorOptions)
+	{
+		rts::IQModulator modulator(makeTransmissions(transmissionOptions), sampleRate, modulatorOptions);
+
+		rts::LogFileOptions logOptions;
+		logOptions.preallocate = 2 * modulator.getSampleCount();
+		rts::LogFileWriter writer(outputFileName, logOptions);
+
+		const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		while (const std::optional<rts::IQBlock> block = modulator.getBlock())
+			writer.write(block->data, 2 * block->size);
+		writer.close();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+		std::cout << "Wrote " << transmissionOptions.count << " transmission(s), "
+			<< std::fixed << std::setprecision(3) << static_cast<double>(modulator.getSampleCount()) / sampleRate
+			<< " s of signal (" << writer.getSize() << " bytes) into '" << outputFileName << "' in "
+			<< elapsed.count() << " s." << std::endl;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	try
+	{
+		std::string outputFileName;
+		Number<uint8_t> key = { 0xa0 };
+		rts::SomfyFrame::Action ctrl = rts::SomfyFrame::Action::up;
+		Number<uint16_t> rollingCode = { 0 };
+		Number<uint32_t> address = { 0x123456 };
+		Number<uint32_t> nRepeatFrames = { DEFAULT_REPEAT_FRAMES };
+		size_t count = DEFAULT_COUNT;
+		unsigned gap = DEFAULT_GAP;
+		size_t sampleRate = DEFAULT_SAMPLE_RATE;
+		rts::IQModulatorOptions modulatorOptions;
+		unsigned jitter = DEFAULT_JITTER;
+
+		boost::program_options::options_description argDescription("Available options");
+		argDescription.add_options()
+			("output,o", boost::program_options::value(&outputFileName)->required(),
+				"The IQ file to write (rtl-sdr format, i.e. interleaved unsigned 8-bit I and Q).")
+			("key,k", boost::program_options::value(&key),
+				"Key value in the packet. Default: 0xa0")
+			("control,c", boost::program_options::value(&ctrl),
+				(std::string("Control code - what operation shall be done. One of ") + getAllActionNames() + ". Default: up").c_str())
+			("rolling-code,r", boost::program_options::value(&rollingCode),
+				"Rolling code of the first transmission, each further transmission increases it by one. Default: 0")
+			("address,a", boost::program_options::value(&address),
+				"Address. Default: 0x123456")
+			("repeat-frames,R", boost::program_options::value(&nRepeatFrames),
+				(std::string("Number of repeat frames in each transmission. Default: ") + std::to_string(DEFAULT_REPEAT_FRAMES)).c_str())
+			("count,n", boost::program_options::value(&count),
+				(std::string("Number of transmissions. Default: ") + std::to_string(DEFAULT_COUNT)).c_str())
+			("gap,g", boost::program_options::value(&gap),
+				(std::string("Silence before, between and after the transmissions, in ms. Default: ") + std::to_string(DEFAULT_GAP)).c_str())
+			("sample-rate,s", boost::program_options::value(&sampleRate),
+				(std::string("Sample rate in S/s (sdr-somfy-decoder expects 2.6 MHz). Default: ") + std::to_string(DEFAULT_SAMPLE_RATE)).c_str())
+			("snr", boost::program_options::value(&modulatorOptions.snr),
+				(std::string("Signal to noise ratio in dB. Default: ") + std::to_string(modulatorOptions.snr)).c_str())
+			("frequency-offset", boost::program_options::value(&modulatorOptions.frequencyOffset),
+				(std::string("Offset of the carrier from the center frequency in Hz. Default: ") + std::to_string(modulatorOptions.frequencyOffset)).c_str())
+			("amplitude", boost::program_options::value(&modulatorOptions.amplitude),
+				(std::string("Amplitude of the carrier (the full scale is 127.5). Default: ") + std::to_string(modulatorOptions.amplitude)).c_str())
+			("jitter", boost::program_options::value(&jitter),
+				(std::string("Standard deviation of the timing of the edges in µs. Default: ") + std::to_string(DEFAULT_JITTER)).c_str())
+			("seed", boost::program_options::value(&modulatorOptions.seed),
+				(std::string("Seed of the noise and the jitter. Default: ") + std::to_string(modulatorOptions.seed)).c_str())
+			("help,h", "print this help")
+		;
+
+		boost::program_options::variables_map variablesMap;
+		boost::program_options::store(boost::program_options::parse_command_line(argc, argv, argDescription), variablesMap);
+
+		if (variablesMap.count("help"))
+		{
+			std::cout << argDescription << "\n";
+			return 1;
+		}
+
+		boost::program_options::notify(variablesMap);
+
+		if (sampleRate == 0)
+			throw boost::program_options::invalid_option_value(std::to_string(sampleRate));
+
+		if (modulatorOptions.amplitude < 0 || modulatorOptions.amplitude > 127.5f)
+			throw boost::program_options::invalid_option_value(std::to_string(modulatorOptions.amplitude));
+
+		modulatorOptions.jitter = std::chrono::microseconds(jitter);
+
+		const TransmissionOptions transmissionOptions{
+			rts::SomfyFrame(key.value, ctrl, rollingCode.value, address.value),
+			nRepeatFrames.value,
+			count,
+			std::chrono::milliseconds(gap)
+		};
+
+		generate(outputFileName, transmissionOptions, sampleRate, modulatorOptions);
+	}
+	catch (const boost::program_options::error & e)
+	{
+		std::cerr << e.what() << "\n";
+		return 1;
+	}
+
+	return 0;
+}
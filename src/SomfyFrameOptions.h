@@ -0,0 +1,104 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SOMFY_FRAME_OPTIONS_H
+#define SOMFY_FRAME_OPTIONS_H
+
+#include <cstddef>
+#include <istream>
+#include <limits>
+#include <map>
+#include <string>
+#include <type_traits>
+
+#include "rts/SomfyFrame.h"
+
+// parsing of Somfy frame fields given on the command line (by boost::program_options)
+
+inline const std::map<std::string, rts::SomfyFrame::Action> ACTION_NAMES =
+{
+	{ "up", rts::SomfyFrame::Action::up },
+	{ "down", rts::SomfyFrame::Action::down },
+	{ "my", rts::SomfyFrame::Action::my },
+	{ "my+down", rts::SomfyFrame::Action::my_down },
+	{ "up+down", rts::SomfyFrame::Action::up_down },
+	{ "flag", rts::SomfyFrame::Action::flag },
+	{ "sun+flag", rts::SomfyFrame::Action::sun_flag },
+	{ "prog", rts::SomfyFrame::Action::prog }
+};
+
+// e.g. "up, down, my" for help texts
+inline std::string getAllActionNames()
+{
+	std::string allActions;
+	for (const auto & actionItem : ACTION_NAMES)
+	{
+		if (!allActions.empty())
+			allActions += ", ";
+		allActions += actionItem.first;
+	}
+
+	return allActions;
+}
+
+// defined in namespace rts because of Argument-dependent lookup
+namespace rts
+{
+	inline std::istream & operator>>(std::istream & in, SomfyFrame::Action & action)
+	{
+		std::string token;
+		in >> token;
+
+		auto it = ACTION_NAMES.find(token);
+		if (it != ACTION_NAMES.end())
+			action = it->second;
+		else
+			in.setstate(std::ios_base::failbit);
+
+		return in;
+	}
+}
+
+// a simple wrapper around an integral type used solely to let boost::program_options
+// parse the input value ourselves - to enable hex input (0x...)
+template<typename T>
+struct Number
+{
+	static_assert(std::is_integral<T>::value && std::is_unsigned<T>::value, "T must be an unsigned integral type!");
+	T value;
+};
+
+template<typename T>
+std::istream & operator>>(std::istream & in, Number<T> & n)
+{
+	std::string token;
+	in >> token;
+
+	static_assert(std::numeric_limits<T>::max() <= std::numeric_limits<unsigned long long>::max(),
+		"T must fit in unsigned long long");
+
+	size_t numConverted = 0;
+	n.value = static_cast<T>(std::stoull(token, &numConverted, 0));
+
+	if (numConverted != token.size())
+		in.setstate(std::ios_base::failbit);
+
+	return in;
+}
+
+#endif // SOMFY_FRAME_OPTIONS_H
@@ -0,0 +1,272 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <cstddef>
+#include <cstdlib>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <atomic>
+#include <new>
+#include <optional>
+
+#include <sys/resource.h>
+
+#include "DurationTracker.h"
+#include "SomfyDecoder.h"
+#include "SomfyFrameEvent.h"
+#include "backend/rtlsdr/IQBlock.h"
+#include "backend/rtlsdr/MemoryIQSource.h"
+#include "backend/rtlsdr/CICDecimator.h"
+#include "backend/rtlsdr/OOKDecoder.h"
+#include "backend/rtlsdr/OOKDemodulator.h"
+#include "backend/rtlsdr/FixedPointOOKDemodulator.h"
+
+#include "BenchSignal.h"
+
+/*
+ * Measure the whole decoding chain of sdr-somfy-decoder on a synthetic signal:
+ * CICDecimator -> OOKDecoder -> DurationTracker -> SomfyDecoder.
+ *
+ * Run as bench-decoder [--json] [seconds of signal to process].
+ *
+ * Besides the throughput, the heap allocations done while decoding are
+ * counted (by replacing the global operator new) and the peak RSS of the
+ * process is reported. The allocations done when setting up the decoding
+ * chain are counted separately, so that allocs/frame doesn't depend on the
+ * length of the signal. The peak RSS includes the signal itself (kept in
+ * memory so that reading a file doesn't distort the results).
+ */
+
+using namespace rts;
+
+namespace
+{
+	std::atomic<uint64_t> allocationCount(0);
+}
+
+void * operator new(size_t size)
+{
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void * p = std::malloc(size ? size : 1))
+		return p;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void * p) noexcept
+{
+	std::free(p);
+}
+
+void operator delete(void * p, size_t) noexcept
+{
+	std::free(p);
+}
+
+namespace
+{
+	constexpr size_t SAMPLE_RATE = BENCH_SAMPLE_RATE;
+	constexpr size_t BLOCK_SIZE = 512*1024; // samples, IQLogReader hands out 1 MiB blocks
+	constexpr double TOLERANCE = 0.1; // the default of sdr-somfy-decoder
+
+	struct FrameCounts
+	{
+		uint64_t decoded = 0;
+		uint64_t errors = 0;
+	};
+
+	// SomfyDecoder listener that just counts the frames
+	class CountingListener
+	{
+	public:
+		CountingListener(FrameCounts & counts):
+			m_counts(&counts)
+		{}
+
+		void onEvent(const SomfyFrameEvent & event)
+		{
+			if (event.type == SomfyFrameEvent::Type::frameDecoded)
+				m_counts->decoded++;
+			else if (event.type == SomfyFrameEvent::Type::frameDecodeError)
+				m_counts->errors++;
+		}
+
+	private:
+		FrameCounts * m_counts;
+	};
+
+	struct Result
+	{
+		std::string name;
+		size_t sampleCount;
+		double seconds;
+		FrameCounts frames;
+		uint64_t setupAllocations; // of the last run, constructing the decoding chain
+		uint64_t allocations; // of the last run, in SomfyDecoder::run()
+		long peakRSS; // KiB
+	};
+
+	// in KiB
+	long getPeakRSS()
+	{
+		struct rusage usage;
+		if (getrusage(RUSAGE_SELF, &usage) != 0)
+			return -1;
+
+		return usage.ru_maxrss;
+	}
+
+	template<typename Demodulator>
+	Result benchDecoder(const std::string & name, const std::vector<uint8_t> & iq, size_t decimation)
+	{
+		typedef CICDecimator<MemoryIQSource> Decimator;
+		typedef OOKDecoder<Decimator, Demodulator> Decoder;
+		typedef DurationTracker<Decoder> Tracker;
+
+		const size_t sampleCount = iq.size() / 2;
+		Result result{name, sampleCount, 0, FrameCounts(), 0, 0, 0};
+
+		result.seconds = measureBest([&]() {
+			const uint64_t setupStart = allocationCount.load(std::memory_order_relaxed);
+
+			MemoryIQSource source(IQBlock{iq.data(), sampleCount}, BLOCK_SIZE);
+			Decimator decimator(source, decimation);
+			Decoder ookDecoder(decimator, SAMPLE_RATE / decimation);
+			Tracker tracker(ookDecoder);
+			result.frames = FrameCounts();
+			SomfyDecoder<Tracker, CountingListener> decoder(tracker, TOLERANCE, CountingListener(result.frames));
+
+			const uint64_t runStart = allocationCount.load(std::memory_order_relaxed);
+			decoder.run();
+			const uint64_t runEnd = allocationCount.load(std::memory_order_relaxed);
+
+			result.setupAllocations = runStart - setupStart;
+			result.allocations = runEnd - runStart;
+		});
+
+		result.peakRSS = getPeakRSS();
+		return result;
+	}
+
+	void printResult(const Result & r)
+	{
+		const double samplesPerSecond = r.sampleCount / r.seconds;
+		const double allocationsPerFrame = r.frames.decoded ? double(r.allocations) / r.frames.decoded : 0;
+		std::cout << std::left << std::setw(16) << r.name << std::right
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(8) << samplesPerSecond / 1e6 << " MS/s"
+			<< std::setw(8) << samplesPerSecond / SAMPLE_RATE << "x realtime"
+			<< std::setw(8) << r.frames.decoded / r.seconds << " frames/s"
+			<< std::setw(6) << r.frames.decoded << " frames"
+			<< std::setw(6) << r.frames.errors << " errors"
+			<< std::setw(8) << allocationsPerFrame << " allocs/frame"
+			<< std::setw(6) << r.setupAllocations << " setup allocs"
+			<< std::setw(8) << r.peakRSS / 1024 << " MiB peak RSS" << std::endl;
+	}
+
+	// one JSON object, to be collected and compared across builds and machines
+	void printJSON(double signalSeconds, const std::vector<Result> & results)
+	{
+		std::cout << std::setprecision(6) << "{\n"
+			<< "\t\"benchmark\": \"bench-decoder\",\n"
+#ifdef __VERSION__
+			<< "\t\"compiler\": \"" << __VERSION__ << "\",\n"
+#endif
+			<< "\t\"pointer_bits\": " << sizeof(void*) * 8 << ",\n"
+			<< "\t\"sample_rate\": " << SAMPLE_RATE << ",\n"
+			<< "\t\"signal_seconds\": " << signalSeconds << ",\n"
+			<< "\t\"repetitions\": " << BENCH_REPETITIONS << ",\n"
+			<< "\t\"results\": [";
+
+		for (size_t i = 0; i < results.size(); i++)
+		{
+			const Result & r = results[i];
+			const double samplesPerSecond = r.sampleCount / r.seconds;
+			std::cout << (i ? ",\n" : "\n") << "\t\t{"
+				<< "\"name\": \"" << r.name << "\", "
+				<< "\"seconds\": " << r.seconds << ", "
+				<< "\"samples_per_second\": " << samplesPerSecond << ", "
+				<< "\"realtime_factor\": " << samplesPerSecond / SAMPLE_RATE << ", "
+				<< "\"frames\": " << r.frames.decoded << ", "
+				<< "\"frame_errors\": " << r.frames.errors << ", "
+				<< "\"frames_per_second\": " << r.frames.decoded / r.seconds << ", "
+				<< "\"setup_allocations\": " << r.setupAllocations << ", "
+				<< "\"allocations\": " << r.allocations << ", "
+				<< "\"allocations_per_frame\": " << (r.frames.decoded ? double(r.allocations) / r.frames.decoded : 0) << ", "
+				<< "\"peak_rss_kib\": " << r.peakRSS << "}";
+		}
+
+		std::cout << "\n\t]\n}" << std::endl;
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	const std::string usage = std::string("usage: ") + argv[0] + " [--json] [seconds of signal to process]";
+
+	bool json = false;
+	std::optional<double> signalSeconds;
+	for (int i = 1; i < argc; i++)
+	{
+		const std::string arg(argv[i]);
+		if (arg == "--help" || arg == "-h")
+		{
+			std::cout << usage << std::endl;
+			return 0;
+		}
+		else if (arg == "--json")
+			json = true;
+		else
+		{
+			// the length of the signal can be given only once
+			const std::optional<double> seconds = signalSeconds ? std::nullopt : parseSignalSeconds(arg);
+			if (!seconds)
+			{
+				std::cerr << "invalid argument: " << arg << std::endl << usage << std::endl;
+				return 1;
+			}
+			signalSeconds = seconds;
+		}
+	}
+
+	if (!signalSeconds)
+		signalSeconds = 10.0;
+
+	const std::vector<uint8_t> iq = makeIQ(static_cast<size_t>(*signalSeconds * SAMPLE_RATE));
+
+	if (!json)
+		std::cout << "decoding " << *signalSeconds << " s of signal at " << SAMPLE_RATE << " S/s"
+			<< " (" << iq.size() / (1024*1024) << " MiB in memory)" << std::endl;
+
+	std::vector<Result> results;
+	results.push_back(benchDecoder<OOKDemodulator<SIMDMagnitude>>("simd", iq, 1));
+	results.push_back(benchDecoder<FixedPointOOKDemodulator>("fixed", iq, 1));
+	results.push_back(benchDecoder<OOKDemodulator<SIMDMagnitude>>("cic/13 + simd", iq, 13));
+	results.push_back(benchDecoder<FixedPointOOKDemodulator>("cic/13 + fixed", iq, 13));
+
+	if (json)
+		printJSON(*signalSeconds, results);
+	else
+		for (const Result & r: results)
+			printResult(r);
+
+	return 0;
+}
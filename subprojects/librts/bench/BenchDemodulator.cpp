@@ -0,0 +1,199 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <complex>
+#include <string>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <optional>
+
+#include "backend/rtlsdr/OOKDemodulator.h"
+#include "backend/rtlsdr/FixedPointOOKDemodulator.h"
+#include "backend/rtlsdr/CICDecimator.h"
+#include "backend/rtlsdr/Filter.h"
+#include "backend/rtlsdr/RTLSDRBufferReader.h"
+
+#include "BenchSignal.h"
+
+/*
+ * Compare the throughput of the OOK demodulation front ends, including the
+ * integer-only FixedPointOOKDemodulator.
+ *
+ * Run as bench-demodulator [seconds of signal to process].
+ */
+
+using namespace rts;
+
+namespace
+{
+	constexpr size_t SAMPLE_RATE = BENCH_SAMPLE_RATE;
+	constexpr size_t BLOCK_SIZE = 128*1024; // samples, i.e. a 256 KiB rtl-sdr buffer
+
+	// the filter OOKDecoder uses at 2.6 MHz, designed at compile time
+	constexpr FirstOrderFilterCoefficients FILTER = designLowPassFilter(100e3, SAMPLE_RATE);
+	constexpr float THRESHOLD = 1.4142135623730950488f / 2;
+
+	void report(const std::string & name, size_t sampleCount, double seconds, uint64_t checksum)
+	{
+		const double samplesPerSecond = sampleCount / seconds;
+		std::cout << std::left << std::setw(20) << name << std::right
+			<< std::fixed << std::setprecision(1)
+			<< std::setw(10) << samplesPerSecond / 1e6 << " MS/s"
+			<< std::setw(10) << samplesPerSecond / SAMPLE_RATE << "x realtime"
+			<< "  (checksum " << std::hex << checksum << std::dec << ")" << std::endl;
+	}
+
+	template<typename Demodulator>
+	void benchDemodulator(const std::string & name, const std::vector<uint8_t> & iq)
+	{
+		const size_t sampleCount = iq.size() / 2;
+		std::vector<uint64_t> bits((BLOCK_SIZE + 63) / 64);
+		uint64_t checksum = 0;
+
+		const double seconds = measureBest([&]() {
+			Demodulator demodulator(FILTER.a, FILTER.b, THRESHOLD);
+			checksum = 0;
+			for (size_t offset = 0; offset < sampleCount; offset += BLOCK_SIZE)
+			{
+				const size_t n = std::min(BLOCK_SIZE, sampleCount - offset);
+				demodulator.process(iq.data() + 2*offset, n, bits.data());
+				for (size_t i = 0; i < (n + 63) / 64; i++)
+					checksum += __builtin_popcountll(bits[i]);
+			}
+		});
+
+		report(name, sampleCount, seconds, checksum);
+	}
+
+	// hands out the IQ data in BLOCK_SIZE blocks, like RTLSDRIQSource does
+	class BlockSource
+	{
+	public:
+		BlockSource(const std::vector<uint8_t> & iq):
+			m_iq(iq),
+			m_offset(0)
+		{}
+
+		std::optional<IQBlock> getBlock()
+		{
+			const size_t n = std::min(BLOCK_SIZE, m_iq.size() / 2 - m_offset);
+			if (n == 0)
+				return std::nullopt;
+
+			const IQBlock block{m_iq.data() + 2*m_offset, n};
+			m_offset += n;
+			return block;
+		}
+
+	private:
+		const std::vector<uint8_t> & m_iq;
+		size_t m_offset;
+	};
+
+	// decimate by CICDecimator first, then demodulate at the reduced rate
+	template<typename Demodulator>
+	void benchDecimated(const std::string & name, const std::vector<uint8_t> & iq, size_t decimation)
+	{
+		const size_t sampleCount = iq.size() / 2;
+		std::vector<uint64_t> bits((BLOCK_SIZE + 63) / 64);
+		uint64_t checksum = 0;
+
+		const double seconds = measureBest([&]() {
+			BlockSource source(iq);
+			CICDecimator<BlockSource> decimator(source, decimation);
+			const FirstOrderFilterCoefficients filter = designLowPassFilter(SAMPLE_RATE / decimation / 4.0, SAMPLE_RATE / decimation);
+			Demodulator demodulator(filter.a, filter.b, THRESHOLD);
+			checksum = 0;
+			while (const std::optional<IQBlock> block = decimator.getBlock())
+			{
+				demodulator.process(block->data, block->size, bits.data());
+				for (size_t i = 0; i < (block->size + 63) / 64; i++)
+					checksum += __builtin_popcountll(bits[i]);
+			}
+		});
+
+		// report the rate of the input samples, to be comparable with the others
+		report(name, sampleCount, seconds, checksum);
+	}
+
+	// the original per-sample path: std::abs() + Filter
+	void benchPerSample(const std::vector<uint8_t> & iq)
+	{
+		const size_t sampleCount = iq.size() / 2;
+		uint64_t checksum = 0;
+
+		const double seconds = measureBest([&]() {
+			Filter filter(FILTER);
+			RTLSDRBufferReader reader;
+			reader.reset(iq.data(), iq.size());
+			checksum = 0;
+			for (size_t i = 0; i < sampleCount; i++)
+				checksum += (filter << std::abs(reader[i])) >= THRESHOLD;
+		});
+
+		report("per-sample", sampleCount, seconds, checksum);
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	const std::string usage = std::string("usage: ") + argv[0] + " [seconds of signal to process]";
+
+	double signalSeconds = 10.0;
+	if (argc > 1)
+	{
+		const std::string arg(argv[1]);
+		if (arg == "--help" || arg == "-h")
+		{
+			std::cout << usage << std::endl;
+			return 0;
+		}
+
+		const std::optional<double> seconds = parseSignalSeconds(arg);
+		if (!seconds || argc > 2)
+		{
+			std::cerr << "invalid arguments" << std::endl << usage << std::endl;
+			return 1;
+		}
+		signalSeconds = *seconds;
+	}
+
+	const std::vector<uint8_t> iq = makeIQ(static_cast<size_t>(signalSeconds * SAMPLE_RATE));
+
+	std::cout << "demodulating " << signalSeconds << " s of signal at " << SAMPLE_RATE << " S/s" << std::endl;
+
+	benchPerSample(iq);
+	benchDemodulator<OOKDemodulator<ScalarMagnitude>>("scalar", iq);
+	benchDemodulator<OOKDemodulator<SIMDMagnitude>>("simd", iq);
+	benchDemodulator<OOKDemodulator<LUTMagnitude>>("lut", iq);
+	benchDemodulator<FixedPointOOKDemodulator>("fixed", iq);
+	benchDecimated<OOKDemodulator<SIMDMagnitude>>("cic/13 + simd", iq, 13);
+	benchDecimated<FixedPointOOKDemodulator>("cic/13 + fixed", iq, 13);
+	benchDecimated<OOKDemodulator<SIMDMagnitude>>("cic/26 + simd", iq, 26);
+
+	// no signal, most of the time: the quiet segments are skipped
+	const std::vector<uint8_t> quietIQ = makeIQ(static_cast<size_t>(signalSeconds * SAMPLE_RATE), true);
+	benchDemodulator<OOKDemodulator<SIMDMagnitude>>("simd (quiet)", quietIQ);
+	benchDemodulator<FixedPointOOKDemodulator>("fixed (quiet)", quietIQ);
+
+	return 0;
+}
@@ -0,0 +1,309 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+#include <vector>
+#include <string>
+#include <random>
+#include <chrono>
+#include <optional>
+#include <iterator>
+#include <iostream>
+
+#include <boost/circular_buffer.hpp>
+
+#include "Clock.h"
+#include "Duration.h"
+#include "DurationBuffer.h"
+#include "DurationTracker.h"
+#include "Transition.h"
+#include "ManchesterDecoder.h"
+#include "ManchesterEncoder.h"
+#include "SomfyFrame.h"
+#include "SomfyFrameEncoder.h"
+#include "SomfyFrameMatcher.h"
+#include "backend/rpi-gpio/TransitionRing.h"
+#include "backend/rtlsdr/Filter.h"
+
+#include "MicroBench.h"
+
+/*
+ * Micro-benchmarks of the per-transition and per-frame code of librts.
+ * No GPIO or SDR hardware is needed.
+ *
+ * Run as bench-micro [substring of the names of the benchmarks to run].
+ */
+
+using namespace rts;
+
+namespace
+{
+	constexpr double SAMPLE_RATE = 2.6e6;
+	constexpr double TOLERANCE = 0.1; // the default of the decoders
+	constexpr size_t RING_CAPACITY = 1000; // the default buffer size of gpio-somfy-decoder
+
+	constexpr SomfyFrame FRAME(0xa0, SomfyFrame::Action::up, 0x1234, 0x123456);
+
+	// the bits of FRAME as ManchesterDecoder has them
+	constexpr uint64_t getFrameWord()
+	{
+		uint64_t word = 0;
+		for (uint8_t byte: FRAME.getByteArray())
+			word = (word << CHAR_BIT) | byte;
+		return word;
+	}
+	constexpr uint64_t FRAME_WORD = getFrameWord();
+
+	// the payload of a frame, without the header
+	std::vector<Duration> encodeFrame(const SomfyFrame & frame)
+	{
+		ManchesterEncoder encoder;
+		const SomfyFrame::Bytes bytes = frame.getByteArray();
+		for (size_t i = 0; i < SomfyFrame::FRAME_SIZE * CHAR_BIT; i++)
+			encoder << (((bytes[i / CHAR_BIT] << (i % CHAR_BIT)) & 0x80) != 0);
+
+		return encoder.getDurations();
+	}
+
+	// transitions in memory, the source for DurationTracker
+	class TransitionSource
+	{
+	public:
+		TransitionSource(const std::vector<Transition> & transitions):
+			m_transitions(transitions),
+			m_index(0)
+		{}
+
+		std::optional<Transition> get()
+		{
+			if (m_index == m_transitions.size())
+				return std::nullopt;
+
+			return m_transitions[m_index++];
+		}
+
+	private:
+		const std::vector<Transition> & m_transitions;
+		size_t m_index;
+	};
+
+	template<size_t ORDER>
+	void benchFilter(MicroBench & bench, const std::vector<float> & magnitudes)
+	{
+		Filter filter(ButterworthDesign::lowPass<ORDER>(100e3, SAMPLE_RATE));
+		bench.run("Filter<" + std::to_string(ORDER + 1) + "," + std::to_string(ORDER + 1) + ">::operator<<", magnitudes.size(), [&]() {
+			float sum = 0;
+			for (float m: magnitudes)
+				sum += filter << m;
+			doNotOptimize(sum);
+		});
+	}
+
+	void benchFrameMatcher(MicroBench & bench)
+	{
+		// what SomfyDecoder feeds the matcher: transmissions, including the payload
+		DurationBuffer buffer;
+		for (uint16_t rollingCode = 0; rollingCode < 10; rollingCode++)
+			SomfyFrameEncoder::appendTransmission(buffer, SomfyFrame(0xa0, SomfyFrame::Action::up, rollingCode, 0x123456), 2);
+		const std::vector<Duration> & durations = buffer.get();
+
+		SomfyFrameMatcher matcher(TOLERANCE);
+		bench.run("SomfyFrameMatcher::newTransition", durations.size(), [&]() {
+			matcher.reset();
+			for (const Duration & d: durations)
+			{
+				const std::optional<SomfyFrameMatcher::FrameMatch> match = matcher.newTransition(d);
+				doNotOptimize(match);
+			}
+		});
+	}
+
+	void benchManchesterDecoder(MicroBench & bench)
+	{
+		constexpr size_t FRAMES = 100;
+		const std::vector<Duration> durations = encodeFrame(FRAME);
+
+		// make sure the durations are decoded as a whole frame
+		ManchesterDecoder<SomfyFrame::FRAME_SIZE * CHAR_BIT> decoder;
+		for (const Duration & d: durations)
+			decoder.newTransition(d);
+		if (decoder.getWord() != FRAME_WORD)
+			std::cerr << "ManchesterDecoder decoded " << decoder.getDecodedBitsCount() << " bits incorrectly" << std::endl;
+
+		bench.run("ManchesterDecoder::newTransition", FRAMES * durations.size(), [&]() {
+			for (size_t i = 0; i < FRAMES; i++)
+			{
+				decoder.reset();
+				for (const Duration & d: durations)
+					decoder.newTransition(d);
+				doNotOptimize(decoder.getWord());
+			}
+		});
+	}
+
+	void benchSomfyFrame(MicroBench & bench)
+	{
+		constexpr size_t COUNT = 10000;
+		const std::vector<uint8_t> bytes = FRAME.getBytes();
+
+		bench.run("SomfyFrame::getBytes", COUNT, [&]() {
+			for (size_t i = 0; i < COUNT; i++)
+			{
+				const std::vector<uint8_t> b = FRAME.getBytes();
+				doNotOptimize(b);
+			}
+		});
+
+		bench.run("SomfyFrame::fromBytes", COUNT, [&]() {
+			for (size_t i = 0; i < COUNT; i++)
+			{
+				const SomfyFrame frame = SomfyFrame::fromBytes(bytes);
+				doNotOptimize(frame);
+			}
+		});
+
+		bench.run("SomfyFrame::getByteArray", COUNT, [&]() {
+			for (size_t i = 0; i < COUNT; i++)
+			{
+				const SomfyFrame::Bytes b = FRAME.getByteArray();
+				doNotOptimize(b);
+			}
+		});
+
+		const SomfyFrame::Bytes byteArray = FRAME.getByteArray();
+		bench.run("SomfyFrame::tryFromBytes", COUNT, [&]() {
+			for (size_t i = 0; i < COUNT; i++)
+			{
+				const std::optional<SomfyFrame> frame = SomfyFrame::tryFromBytes(byteArray);
+				doNotOptimize(frame);
+			}
+		});
+
+		// what noise decoded as a frame costs
+		std::vector<uint8_t> badBytes = bytes;
+		badBytes.back() ^= 1;
+		bench.run("SomfyFrame::fromBytes (bad)", COUNT, [&]() {
+			for (size_t i = 0; i < COUNT; i++)
+			{
+				try
+				{
+					const SomfyFrame frame = SomfyFrame::fromBytes(badBytes);
+					doNotOptimize(frame);
+				}
+				catch (const WrongFrameChecksumException &)
+				{}
+			}
+		});
+
+		SomfyFrame::Bytes badByteArray = byteArray;
+		badByteArray.back() ^= 1;
+		bench.run("SomfyFrame::tryFromBytes (bad)", COUNT, [&]() {
+			for (size_t i = 0; i < COUNT; i++)
+			{
+				const std::optional<SomfyFrame> frame = SomfyFrame::tryFromBytes(badByteArray);
+				doNotOptimize(frame);
+			}
+		});
+	}
+
+	void benchManchesterEncoder(MicroBench & bench)
+	{
+		constexpr size_t FRAMES = 1000;
+		const SomfyFrame::Bytes bytes = FRAME.getByteArray();
+
+		// one operation is a bit
+		bench.run("ManchesterEncoder::operator<<", FRAMES * SomfyFrame::FRAME_SIZE * CHAR_BIT, [&]() {
+			for (size_t i = 0; i < FRAMES; i++)
+			{
+				ManchesterEncoder encoder;
+				for (size_t j = 0; j < SomfyFrame::FRAME_SIZE * CHAR_BIT; j++)
+					encoder << (((bytes[j / CHAR_BIT] << (j % CHAR_BIT)) & 0x80) != 0);
+				doNotOptimize(encoder.getDurations());
+			}
+		});
+	}
+
+	void benchDurationTracker(MicroBench & bench)
+	{
+		constexpr size_t COUNT = 10000;
+		std::vector<Transition> transitions;
+		Clock::time_point t;
+		for (size_t i = 0; i < COUNT; i++)
+		{
+			t += std::chrono::microseconds(640 + i % 640);
+			transitions.emplace_back(t, i % 2 != 0);
+		}
+
+		bench.run("DurationTracker::get", COUNT - 1, [&]() {
+			TransitionSource source(transitions);
+			DurationTracker<TransitionSource> tracker(source);
+			while (const std::optional<Duration> d = tracker.get())
+				doNotOptimize(d);
+		});
+	}
+
+	// what RecordingThread does, but in a single thread: fill the ring, then drain it
+	void benchTransitionRing(MicroBench & bench)
+	{
+		constexpr size_t ROUNDS = 10;
+		TransitionRing ring(RING_CAPACITY);
+		boost::circular_buffer<Transition> readBuffer(RING_CAPACITY);
+
+		bench.run("TransitionRing::put+drain", ROUNDS * RING_CAPACITY, [&]() {
+			Clock::time_point t;
+			for (size_t r = 0; r < ROUNDS; r++)
+			{
+				for (size_t i = 0; i < RING_CAPACITY; i++)
+				{
+					t += std::chrono::microseconds(10);
+					ring.put(Transition(t, i % 2 != 0));
+				}
+
+				ring.drain(std::back_inserter(readBuffer));
+				doNotOptimize(readBuffer.back());
+				readBuffer.clear();
+			}
+		});
+	}
+}
+
+int main(int argc, char * argv[])
+{
+	MicroBench bench(argc > 1 ? argv[1] : "");
+	bench.printHeader();
+
+	// magnitudes of noise and OOK pulses
+	std::mt19937 generator(1);
+	std::uniform_real_distribution<float> noise(0.0f, 0.1f);
+	std::vector<float> magnitudes(64*1024);
+	for (size_t i = 0; i < magnitudes.size(); i++)
+		magnitudes[i] = noise(generator) + ((i / 1700) % 2 ? 1.0f : 0.0f);
+
+	benchFilter<1>(bench, magnitudes);
+	benchFilter<3>(bench, magnitudes);
+	benchFrameMatcher(bench);
+	benchManchesterDecoder(bench);
+	benchSomfyFrame(bench);
+	benchManchesterEncoder(bench);
+	benchDurationTracker(bench);
+	benchTransitionRing(bench);
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BENCH_SIGNAL_H
+#define BENCH_SIGNAL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <cstdlib>
+#include <cerrno>
+#include <cmath>
+
+#include "Clock.h"
+#include "Duration.h"
+#include "DurationBuffer.h"
+#include "SomfyFrame.h"
+#include "SomfyFrameEncoder.h"
+#include "backend/rtlsdr/IQBlock.h"
+#include "backend/rtlsdr/IQModulator.h"
+
+// synthetic signals and timing shared by the benchmarks
+
+constexpr size_t BENCH_SAMPLE_RATE = 2600000; // the rtl-sdr rate of sdr-somfy-decoder
+constexpr size_t BENCH_REPETITIONS = 5;
+
+// parse the length of the signal to process (a positive number of seconds)
+inline std::optional<double> parseSignalSeconds(const std::string & arg)
+{
+	errno = 0;
+	char * end = nullptr;
+	const double seconds = std::strtod(arg.c_str(), &end);
+	if (arg.empty() || *end != '\0' || errno != 0 || !std::isfinite(seconds) || seconds <= 0)
+		return std::nullopt;
+
+	return seconds;
+}
+
+inline rts::Clock::duration getLength(const std::vector<rts::Duration> & durations)
+{
+	rts::Clock::duration length = rts::Clock::duration::zero();
+	for (const rts::Duration & d: durations)
+		length += d.first;
+
+	return length;
+}
+
+// Somfy transmissions rendered by IQModulator, or just (weak) noise if quiet is set
+inline std::vector<uint8_t> makeIQ(size_t sampleCount, bool quiet = false)
+{
+	const rts::Clock::duration length = rts::sampleTime(sampleCount, BENCH_SAMPLE_RATE);
+
+	rts::DurationBuffer buffer;
+	rts::IQModulatorOptions options;
+	if (quiet)
+	{
+		buffer << rts::Duration(length, false);
+		options.snr = 29; // noise of about 3 (of 127.5)
+	}
+	else
+	{
+		// one transmission after another, with short gaps
+		for (uint16_t rollingCode = 0; getLength(buffer.get()) < length; rollingCode++)
+		{
+			buffer << rts::Duration(std::chrono::milliseconds(20 + rollingCode % 100), false);
+			rts::SomfyFrameEncoder::appendTransmission(buffer, rts::SomfyFrame(0xa0, rts::SomfyFrame::Action::up, rollingCode, 0x123456), 2);
+		}
+	}
+
+	rts::IQModulator modulator(buffer.get(), BENCH_SAMPLE_RATE, options);
+	std::vector<uint8_t> iq;
+	iq.reserve(2*sampleCount);
+	while (const std::optional<rts::IQBlock> block = modulator.getBlock())
+		iq.insert(iq.end(), block->data, block->data + 2*block->size);
+
+	iq.resize(2*sampleCount);
+	return iq;
+}
+
+// the best (shortest) time of BENCH_REPETITIONS runs of f, in seconds
+template<typename F>
+double measureBest(F && f)
+{
+	double best = 0;
+	for (size_t r = 0; r < BENCH_REPETITIONS; r++)
+	{
+		const auto start = std::chrono::steady_clock::now();
+		f();
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+		if (r == 0 || elapsed.count() < best)
+			best = elapsed.count();
+	}
+	return best;
+}
+
+#endif // BENCH_SIGNAL_H
@@ -0,0 +1,109 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef MICRO_BENCH_H
+#define MICRO_BENCH_H
+
+#include <cstddef>
+#include <cmath>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+// keep the compiler from optimizing away the computation of value
+template<typename T>
+inline void doNotOptimize(const T & value)
+{
+	asm volatile("" : : "r"(&value) : "memory");
+}
+
+/**
+ * @brief A minimal harness for micro-benchmarks.
+ *
+ * Each benchmark is a function doing a batch of operations. The batch is run
+ * a few times to warm up the caches and the branch predictors, then it's
+ * timed in a number of runs. The time per operation is reported as
+ * percentiles of the runs, the median being the value to compare and the
+ * spread showing how stable the measurement is.
+ *
+ * Only the benchmarks whose names contain the filter are run.
+ */
+class MicroBench
+{
+public:
+	MicroBench(const std::string & filter, size_t warmupRuns = 5, size_t runs = 101):
+		m_filter(filter),
+		m_warmupRuns(warmupRuns),
+		m_runs(runs)
+	{}
+
+	void printHeader() const
+	{
+		std::cout << "ns per operation (" << m_runs << " runs after " << m_warmupRuns << " warm-up runs)" << std::endl
+			<< std::left << std::setw(32) << "benchmark" << std::right
+			<< std::setw(10) << "min" << std::setw(10) << "p50" << std::setw(10) << "p90"
+			<< std::setw(10) << "p99" << std::setw(10) << "max" << std::setw(12) << "Mops/s" << std::endl;
+	}
+
+	// f() does opsPerRun operations
+	template<typename F>
+	void run(const std::string & name, size_t opsPerRun, F && f)
+	{
+		if (name.find(m_filter) == std::string::npos)
+			return;
+
+		for (size_t i = 0; i < m_warmupRuns; i++)
+			f();
+
+		std::vector<double> nsPerOp(m_runs);
+		for (double & t: nsPerOp)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			f();
+			const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+			t = elapsed.count() / opsPerRun;
+		}
+
+		std::sort(nsPerOp.begin(), nsPerOp.end());
+		const double median = percentile(nsPerOp, 50);
+		std::cout << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(2)
+			<< std::setw(10) << nsPerOp.front()
+			<< std::setw(10) << median
+			<< std::setw(10) << percentile(nsPerOp, 90)
+			<< std::setw(10) << percentile(nsPerOp, 99)
+			<< std::setw(10) << nsPerOp.back()
+			<< std::setw(12) << 1e3 / median << std::endl;
+	}
+
+private:
+	// nearest-rank percentile of sorted values
+	static double percentile(const std::vector<double> & sorted, double p)
+	{
+		const size_t rank = static_cast<size_t>(std::ceil(p / 100 * sorted.size()));
+		return sorted[std::max<size_t>(rank, 1) - 1];
+	}
+
+	const std::string m_filter;
+	const size_t m_warmupRuns;
+	const size_t m_runs;
+};
+
+#endif // MICRO_BENCH_H
@@ -20,10 +20,46 @@
 #define RTS_CLOCK_H
 
 #include <chrono>
+#include <cstdint>
 
 namespace rts
 {
 	typedef std::chrono::high_resolution_clock Clock;
+
+	static_assert(Clock::period::num == 1, "Clock must have a whole number of ticks per second");
+
+	/**
+	 * Time of the sample sampleIndex of a signal sampled at sampleRate
+	 * (relative to sample 0).
+	 *
+	 * This is calculated in integers, so it is exact (up to a tick) however
+	 * long the signal is. The result is rounded up, so that
+	 * sampleCount(sampleTime(n, rate), rate) == n.
+	 */
+	constexpr Clock::duration sampleTime(uint64_t sampleIndex, uint64_t sampleRate)
+	{
+		constexpr uint64_t TICKS_PER_SECOND = Clock::period::den;
+
+		// split to whole seconds and the rest so that nothing overflows
+		const uint64_t seconds = sampleIndex / sampleRate;
+		const uint64_t rest = sampleIndex % sampleRate;
+		return Clock::duration((seconds * TICKS_PER_SECOND) + (rest * TICKS_PER_SECOND + sampleRate - 1) / sampleRate);
+	}
+
+	/**
+	 * The number of (whole) samples of a signal sampled at sampleRate that fit
+	 * in duration. Negative durations give 0.
+	 */
+	constexpr uint64_t sampleCount(Clock::duration duration, uint64_t sampleRate)
+	{
+		constexpr uint64_t TICKS_PER_SECOND = Clock::period::den;
+
+		if (duration.count() <= 0)
+			return 0;
+
+		const uint64_t ticks = duration.count();
+		return (ticks / TICKS_PER_SECOND) * sampleRate + (ticks % TICKS_PER_SECOND) * sampleRate / TICKS_PER_SECOND;
+	}
 }
 
 #endif // RTS_CLOCK_H
@@ -46,15 +46,33 @@ public:
 				return std::nullopt; // no data
 		}
 
-		const std::optional<Transition> transition = m_source.get();
-		if (!transition || transition->second == m_lastTransition->second /*a glitch*/)
-			return std::nullopt;
+		std::optional<Transition> transition = m_source.get();
+
+		// a glitch (e.g. a spike of the other level shorter than OOKDecoder's
+		// minimal pulse) can repeat the current level - the pulse goes on
+		while (transition && transition->second == m_lastTransition->second)
+			transition = m_source.get();
+
+		if (!transition)
+			return std::nullopt; // no more data
 
 		const Duration d(transition->first - m_lastTransition->first, m_lastTransition->second);
 		m_lastTransition = transition;
 		return d;
 	}
 
+	/**
+	 * The time of the transition that ended the last Duration returned by
+	 * get(), std::nullopt if there was none yet.
+	 */
+	std::optional<Clock::time_point> getLastTransitionTime() const
+	{
+		if (!m_lastTransition)
+			return std::nullopt;
+
+		return m_lastTransition->first;
+	}
+
 private:
 	Source & m_source;
 	std::optional<Transition> m_lastTransition;
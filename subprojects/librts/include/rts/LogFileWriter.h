@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_LOG_FILE_WRITER_H
+#define RTS_LOG_FILE_WRITER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace rts
+{
+
+struct LogFileOptions
+{
+	// open the file with O_DIRECT
+	bool directIO = false;
+
+	// bytes to preallocate (fallocate), 0 for none
+	uint64_t preallocate = 0;
+};
+
+/**
+ * @brief Writes a (large) log file using large aligned writes.
+ *
+ * The data is collected in an aligned chunk and the file is written one
+ * whole chunk at a time, at chunk-aligned offsets. This suits slow devices
+ * like SD cards and allows the use of O_DIRECT, i.e. bypassing the page
+ * cache (if the file system doesn't support it, the file is written the
+ * usual way). Optionally, space for the file can be preallocated.
+ *
+ * Errors are reported by throwing std::system_error.
+ */
+class LogFileWriter
+{
+public:
+	LogFileWriter(const std::string & fileName, const LogFileOptions & options = LogFileOptions());
+
+	// closes the file (see close()), errors are ignored
+	~LogFileWriter();
+
+	LogFileWriter(const LogFileWriter &) = delete;
+	LogFileWriter & operator=(const LogFileWriter &) = delete;
+
+	void write(const uint8_t * data, size_t size);
+
+	/**
+	 * Write the rest of the data and close the file. The file is truncated
+	 * to the size of the data, so that no preallocated space is left.
+	 */
+	void close();
+
+	// is O_DIRECT in use?
+	bool isDirectIO() const
+	{
+		return m_directIO;
+	}
+
+	// bytes written so far (by write())
+	uint64_t getSize() const
+	{
+		return m_fileOffset + m_chunkFill;
+	}
+
+	// size of the writes, a multiple of the block size of any reasonable device
+	static constexpr size_t CHUNK_SIZE = 1024*1024;
+
+private:
+	// write the partial chunk (only done when closing)
+	void flush();
+	void writeChunk(size_t size);
+
+	int m_fd;
+	bool m_directIO;
+	uint8_t * m_chunk;
+	size_t m_chunkFill;
+	uint64_t m_fileOffset;
+};
+
+} // namespace rts
+
+#endif // RTS_LOG_FILE_WRITER_H
@@ -19,49 +19,143 @@
 #ifndef RTS_MANCHESTER_DECODER_H
 #define RTS_MANCHESTER_DECODER_H
 
+#include "Clock.h"
 #include "Duration.h"
 
+#include <array>
+#include <chrono>
+#include <climits>
 #include <cstddef>
-#include <utility>
-#include <vector>
+#include <cstdint>
 
 namespace rts
 {
 
+/**
+ * @brief Decodes Manchester coded durations into at most MAX_BITS bits.
+ *
+ * The bits are shifted into a single 64-bit word, so decoding doesn't
+ * allocate. The first bit received ends up as the most significant of the
+ * getDecodedBitsCount() low bits of the word.
+ */
+template<size_t MAX_BITS = 64>
 class ManchesterDecoder
 {
+	static_assert(MAX_BITS > 0 && MAX_BITS <= 64, "the bits must fit in a uint64_t");
+
 public:
-	ManchesterDecoder(size_t expectedBits):
+	ManchesterDecoder():
+		m_word(0),
+		m_bitCount(0),
 		m_started(false),
-		m_waitingHalfSym(false)
+		m_waitingHalfSym(false),
+		m_error(nullptr)
+	{}
+
+	bool newTransition(const Duration & duration)
 	{
-		m_bits.reserve(expectedBits);
-	}
+		const Clock::duration d = duration.first;
+		const bool value = duration.second;
+
+		if (!m_started)
+		{
+			// the first duration has to be a half symbol - always
+			if (d > LONG_SHORT_THRESHOLD)
+				return fail("invalid first transition (half-symbol expected)");
+
+			m_started = true;
+			return pushBit(!value);
+		}
+		else if (m_waitingHalfSym)
+		{
+			if (d > LONG_SHORT_THRESHOLD)
+				return fail("expecting short transition");
 
-	bool newTransition(const Duration & duration);
+			m_waitingHalfSym = false;
+			return pushBit(!value);
+		}
+		else if (d > LONG_SHORT_THRESHOLD)
+		{
+			// full-width symbol -> new bit = !prev bit
+			return pushBit(!value);
+		}
+		else // duration <= LONG_SHORT_THRESHOLD
+		{
+			// half-width symbol
+			m_waitingHalfSym = true;
+			return true;
+		}
+	}
 
 	size_t getDecodedBitsCount() const
 	{
-		return m_bits.size();
+		return m_bitCount;
+	}
+
+	// the decoded bits, the first one is bit getDecodedBitsCount() - 1
+	uint64_t getWord() const
+	{
+		return m_word;
 	}
 
-	const std::vector<bool> & getBits() const
+	// the i-th decoded bit
+	bool getBit(size_t i) const
 	{
-		return m_bits;
+		return (m_word >> (m_bitCount - 1 - i)) & 1;
+	}
+
+	// the last N * CHAR_BIT decoded bits as bytes, MSB first
+	template<size_t N>
+	std::array<uint8_t, N> getBytes() const
+	{
+		static_assert(N * CHAR_BIT <= MAX_BITS, "more bytes than the decoder can hold");
+
+		std::array<uint8_t, N> bytes;
+		for (size_t i = 0; i < N; i++)
+			bytes[i] = static_cast<uint8_t>(m_word >> ((N - 1 - i) * CHAR_BIT));
+
+		return bytes;
+	}
+
+	// why the last newTransition() failed
+	const char * getError() const
+	{
+		return m_error;
 	}
 
 	void reset()
 	{
+		m_word = 0;
+		m_bitCount = 0;
 		m_started = false;
 		m_waitingHalfSym = false;
-		m_bits.clear();
+		m_error = nullptr;
 	}
 
 private:
-	static const Clock::duration LONG_SHORT_THRESHOLD;
+	bool pushBit(bool bit)
+	{
+		if (m_bitCount == MAX_BITS)
+			return fail("too many bits");
+
+		m_word = (m_word << 1) | bit;
+		m_bitCount++;
+		return true;
+	}
+
+	bool fail(const char * error)
+	{
+		m_error = error;
+		return false;
+	}
+
+	static constexpr Clock::duration LONG_SHORT_THRESHOLD = std::chrono::microseconds(962);
+
+	uint64_t m_word;
+	size_t m_bitCount;
 	bool m_started;
 	bool m_waitingHalfSym;
-	std::vector<bool> m_bits;
+	const char * m_error;
 };
 
 } // namespace rts
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_SPSC_QUEUE_H
+#define RTS_SPSC_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <vector>
+#include <optional>
+#include <stdexcept>
+
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace rts
+{
+
+/**
+ * @brief Bounded lock-free single-producer single-consumer queue.
+ *
+ * One thread may push(), another thread may pop(). Neither side ever takes a
+ * lock. The blocking variants spin only on the ring indices and fall back to
+ * a futex only when the queue is empty (full) and the consumer (producer)
+ * has to go to sleep. The other side issues the wake-up syscall only if
+ * somebody is actually sleeping.
+ *
+ * close() can be called from any thread. It wakes up both sides: push() fails
+ * from then on and pop() returns the remaining elements and then std::nullopt.
+ */
+template<typename T>
+class SPSCQueue
+{
+public:
+	SPSCQueue(size_t capacity):
+		m_slots(capacity),
+		m_head(0),
+		m_tail(0),
+		m_consumerSleeping(0),
+		m_producerSleeping(0),
+		m_closed(false)
+	{
+		if (capacity == 0)
+			throw std::runtime_error("capacity must be positive");
+	}
+
+	SPSCQueue(const SPSCQueue &) = delete;
+	SPSCQueue & operator=(const SPSCQueue &) = delete;
+
+	size_t capacity() const
+	{
+		return m_slots.size();
+	}
+
+	// producer only: append value unless the queue is full
+	bool tryPush(T && value)
+	{
+		const size_t tail = m_tail.load(std::memory_order_relaxed);
+		if (tail - m_head.load(std::memory_order_acquire) == m_slots.size())
+			return false;
+
+		m_slots[tail % m_slots.size()] = std::move(value);
+		m_tail.store(tail + 1, std::memory_order_release);
+
+		wake(m_consumerSleeping);
+		return true;
+	}
+
+	// producer only: append value, wait for space if necessary; false if closed
+	bool push(T && value)
+	{
+		while (!m_closed.load(std::memory_order_acquire))
+		{
+			if (tryPush(std::move(value)))
+				return true;
+
+			sleep(m_producerSleeping, [this]() {
+				return m_tail.load(std::memory_order_relaxed) - m_head.load(std::memory_order_acquire) < m_slots.size();
+			});
+		}
+
+		return false;
+	}
+
+	// consumer only: remove the first element unless the queue is empty
+	std::optional<T> tryPop()
+	{
+		const size_t head = m_head.load(std::memory_order_relaxed);
+		if (head == m_tail.load(std::memory_order_acquire))
+			return std::nullopt;
+
+		std::optional<T> value(std::move(m_slots[head % m_slots.size()]));
+		m_head.store(head + 1, std::memory_order_release);
+
+		wake(m_producerSleeping);
+		return value;
+	}
+
+	// consumer only: remove the first element, wait for it if necessary; std::nullopt if closed and empty
+	std::optional<T> pop()
+	{
+		while (true)
+		{
+			if (std::optional<T> value = tryPop())
+				return value;
+
+			if (m_closed.load(std::memory_order_acquire))
+			{
+				// there might have been a push just before close()
+				return tryPop();
+			}
+
+			sleep(m_consumerSleeping, [this]() {
+				return m_head.load(std::memory_order_relaxed) != m_tail.load(std::memory_order_acquire);
+			});
+		}
+	}
+
+	void close()
+	{
+		m_closed.store(true, std::memory_order_release);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		wake(m_consumerSleeping);
+		wake(m_producerSleeping);
+	}
+
+	bool isClosed() const
+	{
+		return m_closed.load(std::memory_order_acquire);
+	}
+
+private:
+	/*
+	 * Announce that this side is going to sleep, re-check the condition and
+	 * sleep if it's still not satisfied. The fence pairs with the fence in
+	 * wake(): either the other side sees the flag or we see its update.
+	 */
+	template<typename Ready>
+	void sleep(std::atomic<uint32_t> & sleeping, Ready && ready)
+	{
+		sleeping.store(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (!ready() && !m_closed.load(std::memory_order_relaxed))
+			futexWait(sleeping, 1);
+
+		sleeping.store(0, std::memory_order_relaxed);
+	}
+
+	static void wake(std::atomic<uint32_t> & sleeping)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (sleeping.load(std::memory_order_relaxed) != 0)
+		{
+			sleeping.store(0, std::memory_order_relaxed);
+			futexWake(sleeping);
+		}
+	}
+
+	static void futexWait(std::atomic<uint32_t> & word, uint32_t expected)
+	{
+		// returns immediately if word != expected; spurious wake-ups are handled by the callers
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+	}
+
+	static void futexWake(std::atomic<uint32_t> & word)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+	}
+
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t) && std::atomic<uint32_t>::is_always_lock_free,
+		"futex needs a plain 32-bit word");
+
+	static constexpr size_t CACHE_LINE_SIZE = 64;
+
+	std::vector<T> m_slots;
+
+	// m_head is written only by the consumer, m_tail only by the producer
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_head;
+	alignas(CACHE_LINE_SIZE) std::atomic<size_t> m_tail;
+
+	alignas(CACHE_LINE_SIZE) std::atomic<uint32_t> m_consumerSleeping;
+	std::atomic<uint32_t> m_producerSleeping;
+	std::atomic<bool> m_closed;
+};
+
+} // namespace rts
+
+#endif // RTS_SPSC_QUEUE_H
@@ -19,21 +19,27 @@
 #ifndef RTS_SOMFY_DECODER_H
 #define RTS_SOMFY_DECODER_H
 
-#include <iostream>
-#include <iomanip>
-#include <sstream>
 #include <optional>
+#include <utility>
+#include <climits>
 
 #include "Duration.h"
 #include "ManchesterDecoder.h"
 #include "SomfyFrameMatcher.h"
 #include "SomfyFrameType.h"
 #include "SomfyFrame.h"
+#include "SomfyFrameEvent.h"
+#include "SomfyFramePrinter.h"
 
 namespace rts
 {
 
-template<typename Source>
+/*
+ * Source provides Durations and the time of the transition that ended the
+ * last of them (getLastTransitionTime(), see DurationTracker). Listener gets
+ * the frames as SomfyFrameEvents (see SomfyFrameEvent.h).
+ */
+template<typename Source, typename Listener = SomfyFramePrinter>
 class SomfyDecoder
 {
 private:
@@ -44,209 +50,109 @@ private:
 	};
 
 public:
-	SomfyDecoder(Source & s, double tolerance):
+	SomfyDecoder(Source & s, double tolerance, Listener listener = Listener()):
 		m_source(s),
-		m_tolerance(tolerance)
+		m_matcher(tolerance),
+		m_listener(std::move(listener)),
+		m_event()
 	{}
 
 	void run()
 	{
-		SomfyFrameMatcher matcher(m_tolerance);
-		ManchesterDecoder decoder(SomfyFrame::FRAME_SIZE * CHAR_BIT);
-
+		// the matcher is built by the constructor, so that run() doesn't allocate
+		m_matcher.reset();
+		FrameDecoder decoder;
 		State state = State::SearchingForFrame;
-		SomfyFrameMatcher::FrameMatch frameMatch;
 
-		std::optional<Duration> duration = m_source.get();
-		while (duration)
+		while (std::optional<Duration> duration = m_source.get())
 		{
-			switch (state)
+			/*
+			 * Headers are looked for also while reading the payload. When a frame
+			 * is cut short and another one follows right away, the long header
+			 * pulses can pass for Manchester symbols, so the decoder wouldn't
+			 * necessarily fail before the new header is over. A new header
+			 * therefore ends the frame being decoded.
+			 */
+			if (std::optional<SomfyFrameMatcher::FrameMatch> frameMatch = m_matcher.newTransition(*duration))
 			{
-			case State::SearchingForFrame:
-				if (auto f = matcher.newTransition(*duration))
-				{
-					frameMatch = *f;
-					onFrameDetected(frameMatch.type);
-					state = State::ReadingPayload;
-					decoder.reset();
-
-					// pass reminder of pulse to the next state (ReadingPayload)
-					if (frameMatch.remainingDuration > Clock::duration::zero())
-						duration = Duration(frameMatch.remainingDuration, frameMatch.state);
-					else
-						duration.reset();
-				}
-				else
-					duration.reset();
-				break;
-
-			case State::ReadingPayload:
-				if (decoder.newTransition(*duration))
-				{
-					if (decoder.getBits().size() == SomfyFrame::FRAME_SIZE * CHAR_BIT)
-					{
-						onFrameDecoded(frameMatch.type, decoder.getBits());
-						state = State::SearchingForFrame;
-					}
-					// else: go on
-				}
-				else
-				{
-					onFrameDecodeError(decoder.getBits());
-					state = State::SearchingForFrame;
-				}
-				duration.reset();
-				break;
-			}
+				if (state == State::ReadingPayload)
+					notify(SomfyFrameEvent::Type::frameDecodeError, decoder, "interrupted by a new frame header");
 
-			if (!duration)
-				duration = m_source.get();
+				m_event.frameType = frameMatch->type;
+				notify(SomfyFrameEvent::Type::frameDetected, decoder);
+				state = State::ReadingPayload;
+				decoder.reset();
+
+				// pass reminder of pulse to the decoder
+				if (frameMatch->remainingDuration > Clock::duration::zero())
+					state = readPayload(decoder, Duration(frameMatch->remainingDuration, frameMatch->state));
+			}
+			else if (state == State::ReadingPayload)
+				state = readPayload(decoder, *duration);
 		}
 	}
 
 private:
-	void onFrameDetected(SomfyFrameType frameType)
-	{
-		std::cout << ">>> GOT SOMFY FRAME [type=";
-		switch (frameType)
-		{
-		case SomfyFrameType::normal:
-			std::cout << "normal";
-			break;
-		case SomfyFrameType::repeat:
-			std::cout << "repeat";
-			break;
-		}
-		std::cout << "] <<<" << std::endl;
-		std::cout.flush();
-	}
+	static constexpr size_t FRAME_BITS = SomfyFrame::FRAME_SIZE * CHAR_BIT;
+	typedef ManchesterDecoder<FRAME_BITS> FrameDecoder;
 
-	void onFrameDecoded(SomfyFrameType frameType, const std::vector<bool> & bits)
+	// returns the next state: the frame is over when it's decoded or broken
+	State readPayload(FrameDecoder & decoder, const Duration & duration)
 	{
-		std::cout << "got all bits!" << std::endl;
-		std::cout << "decoded bits: " << stringifyBits(bits) << std::endl;
-
-		std::vector<uint8_t> bytes = bitsToBytes(bits);
-		std::cout << "decoded bytes: " << stringifyBytes(bytes) << std::endl;
-
-		try
-		{
-			SomfyFrame frame = SomfyFrame::fromBytes(std::move(bytes));
-			dumpFrame(frame);
-		}
-		catch (const WrongFrameChecksumException &)
+		if (!decoder.newTransition(duration))
 		{
-			std::cout << "Wrong frame checksum. :-(" << std::endl;
+			notify(SomfyFrameEvent::Type::frameDecodeError, decoder, decoder.getError());
+			return State::SearchingForFrame;
 		}
-		std::cout.flush();
-	}
-
-	void dumpFrame(const SomfyFrame & frame)
-	{
-		std::cout << "key: 0x" << std::hex << std::setw(2) << static_cast<uint16_t>(frame.getKey()) << std::endl;
-		std::cout << "code: 0x" << std::hex << static_cast<uint16_t>(frame.getCtrl())
-			<< " [" << getButtonName(frame.getCtrl()) << "]" << std::endl;
-		std::cout << "rolling code: 0x" << std::hex << std::setw(4) << std::setfill('0') << frame.getRollingCode() << std::endl;
-		std::cout << "address: 0x" << std::hex << std::setw(6) << frame.getAddress() << std::endl;
-	}
 
-	std::string getButtonName(SomfyFrame::Action code)
-	{
-		typedef SomfyFrame::Action Action;
-
-		switch (code)
+		if (decoder.getDecodedBitsCount() == FRAME_BITS)
 		{
-		case Action::my:
-			return "My";
-
-		case Action::up:
-			return "Up";
-
-		case Action::my_up:
-			return "My + Up";
-
-		case Action::down:
-			return "Down";
-
-		case Action::my_down:
-			return "My + Down";
-
-		case Action::up_down:
-			return "Up + Down";
-
-		case Action::prog:
-			return "Prog";
-
-		case Action::sun_flag:
-			return "Sun + Flag";
-
-		case Action::flag:
-			return "Flag";
-
-		default:
-			return "unknown";
+			notify(SomfyFrameEvent::Type::frameDecoded, decoder);
+			return State::SearchingForFrame;
 		}
-	}
 
-	void onFrameDecodeError(const std::vector<bool> & bits)
-	{
-		std::cout << "decoding failed after " << bits.size() << " bits!" << std::endl;
-		std::cout << "decoded bits: " << stringifyBits(bits) << std::endl;
-		std::cout.flush();
+		return State::ReadingPayload;
 	}
 
-	std::string stringifyBits(const std::vector<bool> & bits)
+	void notify(SomfyFrameEvent::Type type, const FrameDecoder & decoder, const char * error = nullptr)
 	{
-		std::stringstream s;
-
-		for (size_t i = 0; i < bits.size(); i++)
+		m_event.type = type;
+		m_event.time = m_source.getLastTransitionTime().value_or(Clock::time_point());
+		m_event.bits = 0;
+		m_event.bitCount = 0;
+		m_event.bytes = {};
+		m_event.frame.reset();
+		m_event.error = nullptr;
+
+		switch (type)
 		{
-			if (i != 0 && i % CHAR_BIT == 0)
-				s.put('|');
-			else if (i != 0 && i % (CHAR_BIT/2) == 0)
-				s.put('.');
-			s.put("01"[bits[i]]);
-		}
-		return s.str();
-	}
-
-	std::vector<uint8_t> bitsToBytes(const std::vector<bool> & bits)
-	{
-		if (bits.size() % CHAR_BIT != 0)
-			throw std::runtime_error("Bit count not a multiple of byte size!");
+		case SomfyFrameEvent::Type::frameDetected:
+			break;
 
-		std::vector<uint8_t> bytes;
-		bytes.reserve(bits.size() / CHAR_BIT);
-		for (size_t i = 0; i < bits.size(); i++)
-		{
-			if (i % CHAR_BIT == 0)
-				bytes.push_back(0);
+		case SomfyFrameEvent::Type::frameDecoded:
+			m_event.bits = decoder.getWord();
+			m_event.bitCount = decoder.getDecodedBitsCount();
+			m_event.bytes = decoder.template getBytes<SomfyFrame::FRAME_SIZE>();
+			m_event.frame = SomfyFrame::tryFromBytes(m_event.bytes);
+			if (!m_event.frame)
+				m_event.error = "wrong frame checksum";
+			break;
 
-			if (bits[i])
-			{
-				const uint8_t bitWeight = 1 << (CHAR_BIT - 1 - (i % CHAR_BIT));
-				bytes.back() |= bitWeight;
-			}
+		case SomfyFrameEvent::Type::frameDecodeError:
+			m_event.bits = decoder.getWord();
+			m_event.bitCount = decoder.getDecodedBitsCount();
+			m_event.error = error;
+			break;
 		}
 
-		return bytes;
-	}
-
-	std::string stringifyBytes(const std::vector<uint8_t> & bytes)
-	{
-		std::stringstream s;
-
-		for (size_t i = 0; i < bytes.size(); i++)
-		{
-			if (i != 0)
-				s.put('|');
-			s << std::hex << std::setfill('0') << std::setw(2) << static_cast<uint16_t>(bytes[i]); // uint8_t is printed out as a char
-		}
-		return s.str();
+		m_listener.onEvent(m_event);
 	}
 
 	Source & m_source;
-	const double m_tolerance;
+	SomfyFrameMatcher m_matcher;
+	Listener m_listener;
+
+	SomfyFrameEvent m_event;
 };
 
 } // namespace rts
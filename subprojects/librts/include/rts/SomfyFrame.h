@@ -20,8 +20,11 @@
 #define RTS_SOMFY_FRAME_H
 
 #include <cstdint>
+#include <cstddef>
 #include <climits>
+#include <array>
 #include <vector>
+#include <optional>
 #include <stdexcept>
 
 namespace rts
@@ -33,6 +36,7 @@ public:
 	using std::runtime_error::runtime_error;
 };
 
+// this is based on https://pushstack.wordpress.com/somfy-rts-protocol/
 class SomfyFrame
 {
 public:
@@ -49,7 +53,7 @@ public:
 		flag = 0xa
 	};
 
-	uint8_t getKey() const
+	constexpr uint8_t getKey() const
 	{
 		return m_key;
 	}
@@ -59,7 +63,7 @@ public:
 		m_key = key;
 	}
 
-	Action getCtrl() const
+	constexpr Action getCtrl() const
 	{
 		return m_ctrl;
 	}
@@ -69,7 +73,7 @@ public:
 		m_ctrl= ctrl;
 	}
 
-	uint16_t getRollingCode() const
+	constexpr uint16_t getRollingCode() const
 	{
 		return m_rollingCode;
 	}
@@ -79,7 +83,7 @@ public:
 		m_rollingCode = rollingCode;
 	}
 
-	uint32_t getAddress() const
+	constexpr uint32_t getAddress() const
 	{
 		return m_address;
 	}
@@ -91,16 +95,89 @@ public:
 
 	static constexpr size_t FRAME_SIZE = 7; // Somfy RTS frame size in bytes
 
-	SomfyFrame();
-	SomfyFrame(uint8_t key, Action ctrl, uint16_t rollingCode, uint32_t address);
+	// a frame as transmitted (obfuscated, with the checksum)
+	typedef std::array<uint8_t, FRAME_SIZE> Bytes;
 
-	static SomfyFrame fromBytes(std::vector<uint8_t> bytes);
+	constexpr SomfyFrame():
+		SomfyFrame(0, Action::my, 0, 0)
+	{}
+
+	constexpr SomfyFrame(uint8_t key, Action ctrl, uint16_t rollingCode, uint32_t address):
+		m_key(key),
+		m_ctrl(ctrl),
+		m_rollingCode(rollingCode),
+		m_address(address)
+	{
+		// address is encoded in 3 bytes, so it can only hold values 0x000000 .. 0xffffff
+		if (address > UINT32_C(0xffffff))
+			throw std::runtime_error("Address must be lower than 0x1000000.");
+	}
+
+	/**
+	 * Decode a received frame, std::nullopt if the checksum is wrong. This
+	 * doesn't allocate or throw, so it's cheap even for the garbage received
+	 * in a noisy environment.
+	 */
+	static constexpr std::optional<SomfyFrame> tryFromBytes(Bytes bytes)
+	{
+		deobfuscate(bytes);
+		if (checksum(bytes) != 0)
+			return std::nullopt;
+
+		const uint8_t key = bytes[0];
+		const Action ctrl = static_cast<Action>(bytes[1] >> 4);
+		const uint16_t rollingCode = static_cast<uint16_t>((bytes[2] << 8) | bytes[3]);
+		const uint32_t address = (static_cast<uint32_t>(bytes[4]) << 16) |
+			(static_cast<uint32_t>(bytes[5]) << 8) | bytes[6];
+
+		return SomfyFrame(key, ctrl, rollingCode, address);
+	}
+
+	// encode the frame for transmission
+	constexpr Bytes getByteArray() const
+	{
+		Bytes frame = {
+			m_key,
+			static_cast<uint8_t>(static_cast<uint8_t>(m_ctrl) << 4),
+			static_cast<uint8_t>(m_rollingCode >> CHAR_BIT),
+			static_cast<uint8_t>(m_rollingCode),
+			static_cast<uint8_t>(m_address >> 2*CHAR_BIT),
+			static_cast<uint8_t>(m_address >> 1*CHAR_BIT),
+			static_cast<uint8_t>(m_address >> 0*CHAR_BIT)
+		};
+
+		frame[1] |= checksum(frame);
+		obfuscate(frame);
+		return frame;
+	}
+
+	// like tryFromBytes(), but throws WrongFrameChecksumException (or std::runtime_error if the size is wrong)
+	static SomfyFrame fromBytes(const std::vector<uint8_t> & bytes);
+
+	// like getByteArray()
 	std::vector<uint8_t> getBytes() const;
 
 private:
-	static void deobfuscate(std::vector<uint8_t> & bytes);
-	static void obfuscate(std::vector<uint8_t> & bytes);
-	static uint8_t checksum(const std::vector<uint8_t> & data);
+	static constexpr void deobfuscate(Bytes & bytes)
+	{
+		for (size_t i = bytes.size() - 1; i > 0; i--)
+			bytes[i] ^= bytes[i-1];
+	}
+
+	static constexpr void obfuscate(Bytes & bytes)
+	{
+		for (size_t i = 1; i < bytes.size(); i++)
+			bytes[i] ^= bytes[i-1];
+	}
+
+	static constexpr uint8_t checksum(const Bytes & data)
+	{
+		uint8_t c = 0;
+		for (uint8_t d : data)
+			c = c ^ d ^ (d >> 4);
+
+		return c & 0xf;
+	}
 
 	uint8_t m_key;
 	Action m_ctrl;
@@ -0,0 +1,54 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_SOMFY_FRAME_ENCODER_H
+#define RTS_SOMFY_FRAME_ENCODER_H
+
+#include <cstddef>
+#include <climits>
+
+#include "Duration.h"
+#include "DurationBuffer.h"
+#include "SomfyFrame.h"
+#include "SomfyFrameType.h"
+
+namespace rts
+{
+
+/**
+ * @brief Converts Somfy frames to durations of the carrier being on/off.
+ *
+ * This is what a remote sends: a header (see SomfyFrameHeader.h) and the
+ * Manchester-encoded frame, the frames separated by INTER_FRAME_GAP.
+ */
+class SomfyFrameEncoder
+{
+public:
+	static const Duration INTER_FRAME_GAP;
+
+	// append the header for frameType and the first bitCount bits of frame
+	static void appendFrame(DurationBuffer & buffer, SomfyFrameType frameType, const SomfyFrame & frame,
+		size_t bitCount = SomfyFrame::FRAME_SIZE * CHAR_BIT);
+
+	// append a normal frame and repeatFrameCount repeat frames, each of them followed by INTER_FRAME_GAP
+	static void appendTransmission(DurationBuffer & buffer, const SomfyFrame & frame, size_t repeatFrameCount);
+};
+
+} // namespace rts
+
+#endif // RTS_SOMFY_FRAME_ENCODER_H
@@ -0,0 +1,90 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_SOMFY_FRAME_EVENT_H
+#define RTS_SOMFY_FRAME_EVENT_H
+
+#include <optional>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "Clock.h"
+#include "SomfyFrameType.h"
+#include "SomfyFrame.h"
+
+namespace rts
+{
+
+/**
+ * @brief What SomfyDecoder found in the signal.
+ *
+ * SomfyDecoder passes the events to its listener, which has a single method:
+ *
+ *   void onEvent(const SomfyFrameEvent & event);
+ *
+ * The event is a plain value, it can be copied and kept. See
+ * SomfyFramePrinter for the listener that prints the frames as text.
+ */
+struct SomfyFrameEvent
+{
+	enum class Type
+	{
+		frameDetected,   // a frame header has been matched
+		frameDecoded,    // all the bits of the frame have been received
+		frameDecodeError // the payload of the frame can't be decoded
+	};
+
+	Type type;
+
+	// the header that started the frame
+	SomfyFrameType frameType;
+
+	/*
+	 * The time of the transition that caused the event, as provided by the
+	 * source of SomfyDecoder (e.g. DurationTracker). For an IQ signal this is
+	 * the time stamp of a sample (see OOKDecoder::getSampleTime()).
+	 */
+	Clock::time_point time;
+
+	/*
+	 * The bits received so far (all of them for frameDecoded), see
+	 * ManchesterDecoder: the first bit is bit bitCount - 1 of bits.
+	 */
+	uint64_t bits;
+	size_t bitCount;
+
+	// frameDecoded: the bits as bytes (still obfuscated, as transmitted)
+	std::array<uint8_t, SomfyFrame::FRAME_SIZE> bytes;
+
+	// frameDecoded: the frame, std::nullopt if the checksum is wrong
+	std::optional<SomfyFrame> frame;
+
+	// frameDecodeError, or frameDecoded with a wrong checksum: what went wrong (nullptr if nothing)
+	const char * error;
+
+	// the i-th bit received
+	bool getBit(size_t i) const
+	{
+		return (bits >> (bitCount - 1 - i)) & 1;
+	}
+};
+
+} // namespace rts
+
+#endif // RTS_SOMFY_FRAME_EVENT_H
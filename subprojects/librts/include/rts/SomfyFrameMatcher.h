@@ -21,6 +21,8 @@
 
 #include <optional>
 #include <cstddef>
+#include <cstdint>
+#include <vector>
 
 #include "Clock.h"
 #include "Duration.h"
@@ -29,6 +31,20 @@
 namespace rts
 {
 
+/**
+ * Finds the headers of normal and repeat frames (see SomfyFrameHeader.h)
+ * in a sequence of durations.
+ *
+ * All partial matches of both headers are tracked at once, so a header
+ * is found also when it starts in the middle of another (partial) header,
+ * e.g. a repeat header preceded by an extra HW sync pair. This is done by
+ * a DFA: the durations are quantized into classes (intervals of ticks
+ * bounded by the tolerance windows of the header steps) and the automaton
+ * makes a single table lookup per transition.
+ *
+ * The automaton depends on the tolerance, so it is built when the matcher
+ * is constructed.
+ */
 class SomfyFrameMatcher
 {
 public:
@@ -57,24 +73,54 @@ public:
 	void reset();
 
 private:
-	class SequenceMatcher
+	/**
+	 * The durations accepted for one header step, in integer ticks:
+	 * min <= actual <= max. The last step of a header also accepts anything
+	 * longer than min (the header is followed by the frame data), what is
+	 * over expected is then reported as the remaining duration.
+	 */
+	struct Window
 	{
-	public:
-		SequenceMatcher(const Duration * sequence, size_t sequenceSize);
-		std::optional<Clock::duration> newTransition(const Duration & duration, double tolerance);
-		void reset();
-	private:
-		bool matchDuration(Clock::duration actual, Clock::duration expected, double tolerance);
-		bool matchDurationAtLeast(Clock::duration actual, Clock::duration expected, double tolerance);
-		const Duration *m_sequence;
-		const size_t m_sequenceSize;
-		size_t m_matchedCount;
+		Clock::duration expected;
+		Clock::duration min;
+		Clock::duration max;
+		bool state;
 	};
 
-	const double m_tolerance;
+	// a set of header steps, bit i is step i of the concatenated headers
+	typedef uint32_t StepMask;
+	typedef uint16_t StateIndex;
+
+	static constexpr size_t NO_MATCH = SIZE_MAX;
+
+	static Window makeWindow(const Duration & expected, double tolerance);
+
+	void addHeader(const Duration * durations, size_t count, SomfyFrameType type, double tolerance);
+	StepMask getAcceptedSteps(Clock::duration actual, bool state) const;
+	void buildAutomaton();
+
+	size_t getSymbol(const Duration & duration) const;
+
+	// header steps, the headers one after another
+	std::vector<Window> m_steps;
+	// for each header: its type and the index of its last step
+	std::vector<std::pair<SomfyFrameType, size_t>> m_headers;
+	// first steps of all headers
+	StepMask m_firstSteps;
+
+	/*
+	 * The symbols of the automaton: for each level (false, true), the
+	 * sorted boundaries of the windows split the durations into intervals
+	 * in which all durations are accepted by the same header steps.
+	 */
+	std::vector<Clock::duration> m_boundaries[2];
+	size_t m_symbolCount;
 
-	SequenceMatcher m_matcherNormal;
-	SequenceMatcher m_matcherRepeat;
+	// m_table[state * m_symbolCount + symbol] is the next state
+	std::vector<StateIndex> m_table;
+	// for each state: index to m_headers if a header has been matched, or NO_MATCH
+	std::vector<size_t> m_accepting;
+	StateIndex m_state;
 };
 
 } // namespace rts
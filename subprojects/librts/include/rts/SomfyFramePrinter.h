@@ -0,0 +1,185 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_SOMFY_FRAME_PRINTER_H
+#define RTS_SOMFY_FRAME_PRINTER_H
+
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <array>
+#include <climits>
+#include <cstdint>
+
+#include "SomfyFrameType.h"
+#include "SomfyFrame.h"
+#include "SomfyFrameEvent.h"
+
+namespace rts
+{
+
+/**
+ * @brief Listener for SomfyDecoder that prints the frames to out (stdout by
+ * default).
+ *
+ * The output is flushed once per event, not per line.
+ */
+class SomfyFramePrinter
+{
+public:
+	SomfyFramePrinter(std::ostream & out = std::cout):
+		m_out(out)
+	{}
+
+	void onEvent(const SomfyFrameEvent & event)
+	{
+		switch (event.type)
+		{
+		case SomfyFrameEvent::Type::frameDetected:
+			printFrameDetected(event);
+			break;
+		case SomfyFrameEvent::Type::frameDecoded:
+			printFrameDecoded(event);
+			break;
+		case SomfyFrameEvent::Type::frameDecodeError:
+			printFrameDecodeError(event);
+			break;
+		}
+		m_out.flush();
+	}
+
+private:
+	void printFrameDetected(const SomfyFrameEvent & event)
+	{
+		m_out << ">>> GOT SOMFY FRAME [type=";
+		switch (event.frameType)
+		{
+		case SomfyFrameType::normal:
+			m_out << "normal";
+			break;
+		case SomfyFrameType::repeat:
+			m_out << "repeat";
+			break;
+		}
+		m_out << "] <<<\n";
+	}
+
+	void printFrameDecoded(const SomfyFrameEvent & event)
+	{
+		m_out << "got all bits!\n";
+		m_out << "decoded bits: " << stringifyBits(event) << '\n';
+		m_out << "decoded bytes: " << stringifyBytes(event.bytes) << '\n';
+
+		if (event.frame)
+			dumpFrame(*event.frame);
+		else
+			m_out << "Wrong frame checksum. :-(\n";
+	}
+
+	void printFrameDecodeError(const SomfyFrameEvent & event)
+	{
+		if (event.error)
+			std::cerr << "DECODER error: " << event.error << std::endl;
+
+		m_out << "decoding failed after " << std::dec << event.bitCount << " bits!\n";
+		m_out << "decoded bits: " << stringifyBits(event) << '\n';
+	}
+
+	void dumpFrame(const SomfyFrame & frame)
+	{
+		m_out << "key: 0x" << std::hex << std::setw(2) << std::setfill('0') << static_cast<uint16_t>(frame.getKey()) << '\n';
+		m_out << "code: 0x" << std::hex << static_cast<uint16_t>(frame.getCtrl())
+			<< " [" << getButtonName(frame.getCtrl()) << "]\n";
+		m_out << "rolling code: 0x" << std::hex << std::setw(4) << std::setfill('0') << frame.getRollingCode() << '\n';
+		m_out << "address: 0x" << std::hex << std::setw(6) << frame.getAddress() << '\n';
+	}
+
+	std::string getButtonName(SomfyFrame::Action code)
+	{
+		typedef SomfyFrame::Action Action;
+
+		switch (code)
+		{
+		case Action::my:
+			return "My";
+
+		case Action::up:
+			return "Up";
+
+		case Action::my_up:
+			return "My + Up";
+
+		case Action::down:
+			return "Down";
+
+		case Action::my_down:
+			return "My + Down";
+
+		case Action::up_down:
+			return "Up + Down";
+
+		case Action::prog:
+			return "Prog";
+
+		case Action::sun_flag:
+			return "Sun + Flag";
+
+		case Action::flag:
+			return "Flag";
+
+		default:
+			return "unknown";
+		}
+	}
+
+	std::string stringifyBits(const SomfyFrameEvent & event)
+	{
+		std::stringstream s;
+
+		for (size_t i = 0; i < event.bitCount; i++)
+		{
+			if (i != 0 && i % CHAR_BIT == 0)
+				s.put('|');
+			else if (i != 0 && i % (CHAR_BIT/2) == 0)
+				s.put('.');
+			s.put("01"[event.getBit(i)]);
+		}
+		return s.str();
+	}
+
+	template<size_t N>
+	std::string stringifyBytes(const std::array<uint8_t, N> & bytes)
+	{
+		std::stringstream s;
+
+		for (size_t i = 0; i < bytes.size(); i++)
+		{
+			if (i != 0)
+				s.put('|');
+			s << std::hex << std::setfill('0') << std::setw(2) << static_cast<uint16_t>(bytes[i]); // uint8_t is printed out as a char
+		}
+		return s.str();
+	}
+
+	std::ostream & m_out;
+};
+
+} // namespace rts
+
+#endif // RTS_SOMFY_FRAME_PRINTER_H
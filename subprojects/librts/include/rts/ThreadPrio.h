@@ -24,6 +24,12 @@
 namespace rts
 {
 	void setThreadSchedulerAndPrio(std::thread & thread, int schedAlgo);
+
+	// pin the thread to the given CPU
+	void setThreadAffinity(std::thread & thread, unsigned cpu);
+
+	// pin the calling thread to the given CPU
+	void setCurrentThreadAffinity(unsigned cpu);
 }
 
 #endif // RTS_THREAD_PRIO_H
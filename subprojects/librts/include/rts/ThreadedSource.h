@@ -0,0 +1,132 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_THREADED_SOURCE_H
+#define RTS_THREADED_SOURCE_H
+
+#include <cstddef>
+#include <optional>
+#include <thread>
+#include <mutex>
+#include <utility>
+#include <stdexcept>
+#include <exception>
+
+#include "SPSCQueue.h"
+#include "ThreadPrio.h"
+
+namespace rts
+{
+
+/**
+ * @brief Run a source in its own thread.
+ *
+ * Source is anything with a get() method returning std::optional<T>, like
+ * OOKDecoder (T = Transition) or DurationTracker (T = Duration). After start(),
+ * a thread keeps calling Source::get() and passes the values to get() of
+ * this class via a bounded lock-free queue. So this is a source of T
+ * too and the rest of the chain can run in another thread, e.g.:
+ *
+ *   OOKDecoder<...> ookDecoder(...); // runs in the ThreadedSource's thread
+ *   ThreadedSource<OOKDecoder<...>, Transition> transitions(ookDecoder, 1024);
+ *   DurationTracker<ThreadedSource<...>> durationTracker(transitions);
+ *
+ * The thread ends when Source::get() returns std::nullopt, then get() returns
+ * the remaining values followed by std::nullopt. If Source::get() throws, the
+ * thread ends too and get() rethrows the exception (in the consumer's thread)
+ * after the remaining values. The destructor waits for the
+ * thread, so the source has to reach its end (e.g. the IQ source has to be
+ * stopped) before this is destroyed.
+ */
+template<typename Source, typename T>
+class ThreadedSource
+{
+public:
+	ThreadedSource(Source & source, size_t queueCapacity):
+		m_source(source),
+		m_queue(queueCapacity)
+	{}
+
+	ThreadedSource(const ThreadedSource &) = delete;
+	ThreadedSource & operator=(const ThreadedSource &) = delete;
+
+	~ThreadedSource()
+	{
+		// nobody is going to read the values anymore
+		m_queue.close();
+
+		if (m_thread.joinable())
+			m_thread.join();
+	}
+
+	/**
+	 * Start the thread, optionally pin it to a CPU.
+	 */
+	void start(std::optional<unsigned> cpu = std::nullopt)
+	{
+		if (m_thread.joinable() || m_queue.isClosed())
+			throw std::runtime_error("thread already started");
+
+		m_thread = std::thread(&ThreadedSource::loop, this);
+
+		if (cpu)
+			setThreadAffinity(m_thread, *cpu);
+	}
+
+	std::optional<T> get()
+	{
+		std::optional<T> value = m_queue.pop();
+
+		// m_error is set before the queue is closed
+		if (!value && m_error)
+			std::rethrow_exception(m_error);
+
+		return value;
+	}
+
+private:
+	void loop()
+	{
+		try
+		{
+			while (std::optional<T> value = m_source.get())
+			{
+				if (!m_queue.push(std::move(*value)))
+					return; // closed by the destructor
+			}
+		}
+		catch (...)
+		{
+			// pass it to the consumer
+			m_error = std::current_exception();
+		}
+
+		m_queue.close();
+	}
+
+	Source & m_source;
+	SPSCQueue<T> m_queue;
+	std::thread m_thread;
+
+	// thrown by Source::get(), only written by the thread
+	std::exception_ptr m_error;
+};
+
+} // namespace rts
+
+#endif // RTS_THREADED_SOURCE_H
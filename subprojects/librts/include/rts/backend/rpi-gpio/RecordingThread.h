@@ -20,6 +20,7 @@
 #define RTS_RECORDING_THREAD_H
 
 #include "FastGPIO.h"
+#include "TransitionRing.h"
 #include "../../Clock.h"
 #include "../../Transition.h"
 
@@ -48,8 +49,6 @@ public:
 
 private:
 	void recordingLoop();
-	void put(const Clock::time_point & tp, bool value);
-	Transition * advanceBufferPtr(Transition *ptr);
 
 	const FastGPIO m_gpioReader;
 	const unsigned m_gpioNr;
@@ -59,9 +58,7 @@ private:
 	boost::circular_buffer<Transition> m_readBuffer;
 
 	// buffer shared between the reading and recording threads
-	std::vector<Transition> m_buffer;
-	std::atomic<Transition*> m_writePtr;
-	std::atomic<Transition*> m_readPtr;
+	TransitionRing m_ring;
 
 	std::mutex m_mutex;
 	std::thread m_thread;
@@ -0,0 +1,120 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_TRANSITION_RING_H
+#define RTS_TRANSITION_RING_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <stdexcept>
+#include <algorithm>
+
+#include "../../Transition.h"
+
+namespace rts
+{
+
+/**
+ * @brief Lock-free ring buffer passing transitions from the GPIO recording thread.
+ *
+ * There must be a single producer (put()) and a single consumer (empty() and
+ * drain()). The producer never blocks: when the ring is full, put() drops the
+ * transition. The consumer takes all the available transitions at once.
+ */
+class TransitionRing
+{
+	static_assert(std::atomic<Transition*>::is_always_lock_free,
+		"A lock-free atomic pointer required for good performance.");
+
+public:
+	TransitionRing(size_t capacity):
+		// +1 to account for the fact that there's always at least 1 free element in between to differentiate empty and full
+		m_buffer(capacity + 1)
+	{
+		if (capacity == 0)
+			throw std::runtime_error("capacity must be positive");
+
+		m_writePtr = m_readPtr = &m_buffer.front();
+	}
+
+	TransitionRing(const TransitionRing &) = delete;
+	TransitionRing & operator=(const TransitionRing &) = delete;
+
+	size_t capacity() const
+	{
+		return m_buffer.size() - 1;
+	}
+
+	// producer: returns false if the transition was dropped (no space in the ring)
+	bool put(const Transition & transition)
+	{
+		const Transition * const readPtr = m_readPtr.load(std::memory_order_acquire);
+		Transition * const writePtr = m_writePtr.load(std::memory_order_relaxed);
+		Transition * const advancedWritePtr = advance(writePtr);
+		if (advancedWritePtr == readPtr)
+			return false;
+
+		*writePtr = transition;
+		m_writePtr.store(advancedWritePtr, std::memory_order_release);
+		return true;
+	}
+
+	// consumer
+	bool empty() const
+	{
+		return m_readPtr.load(std::memory_order_relaxed) == m_writePtr.load(std::memory_order_acquire);
+	}
+
+	// consumer: copy all the available transitions to out and mark them as read
+	template<typename OutputIterator>
+	OutputIterator drain(OutputIterator out)
+	{
+		Transition * const readPtr = m_readPtr.load(std::memory_order_relaxed);
+		Transition * const writePtr = m_writePtr.load(std::memory_order_acquire);
+
+		if (readPtr <= writePtr)
+			out = std::copy(readPtr, writePtr, out);
+		else
+		{
+			out = std::copy(readPtr, m_buffer.data() + m_buffer.size(), out);
+			out = std::copy(m_buffer.data(), writePtr, out);
+		}
+
+		m_readPtr.store(writePtr, std::memory_order_release);
+		return out;
+	}
+
+private:
+	Transition * advance(Transition * ptr)
+	{
+		ptr++;
+		if (ptr == m_buffer.data() + m_buffer.size())
+			ptr = m_buffer.data();
+
+		return ptr;
+	}
+
+	std::vector<Transition> m_buffer;
+	std::atomic<Transition*> m_writePtr;
+	std::atomic<Transition*> m_readPtr;
+};
+
+} // namespace rts
+
+#endif // RTS_TRANSITION_RING_H
@@ -0,0 +1,393 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_BASIC_RTLSDR_IQ_SOURCE_H
+#define RTS_BASIC_RTLSDR_IQ_SOURCE_H
+
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <optional>
+#include <vector>
+#include <string>
+#include <memory>
+#include <stdexcept>
+#include <system_error>
+#include <iostream>
+#include <algorithm>
+#include <assert.h>
+
+#include "../../SPSCQueue.h"
+#include "../../ThreadPrio.h"
+#include "../../LogFileWriter.h"
+#include "IQBlock.h"
+
+namespace rts
+{
+
+/**
+ * @brief IQ source that reads samples from a rtl-sdr device in a separate thread.
+ *
+ * Device is RTLSDRDevice, or anything that provides the same read methods:
+ *
+ *   size_t readSync(uint8_t * buffer, size_t size);
+ *   void readAsync(const std::function<void(uint8_t*, size_t)> & callback,
+ *     uint32_t transferCount, uint32_t transferLength);
+ *   void cancelAsync();
+ *
+ * In the sync mode, the recording thread reads into bufferCount buffers
+ * of bufferSize bytes owned by the source, with no USB transfers queued
+ * in between the reads.
+ *
+ * In the async mode, the device keeps bufferCount USB transfers of
+ * bufferSize bytes queued and the buffers of completed transfers are passed
+ * to the consumer without copying. The device's callback waits until the
+ * consumer is done with the buffer, the remaining transfers are being filled
+ * meanwhile. After stop() the consumer has to keep calling getBlock() until
+ * it returns std::nullopt.
+ *
+ * If the device stops delivering data on its own (readAsync() returns before
+ * stop() is called), getBlock() returns std::nullopt once all recorded data
+ * has been consumed.
+ *
+ * If logName is given, the raw samples are written into that file by a
+ * separate thread (see LogFileWriter), so that slow writes don't hold up the
+ * consumer. In the sync mode, the consumer passes each buffer it's done with
+ * to the log thread which writes it and only then returns it to the free
+ * buffers. In the async mode, the device's buffers are returned as soon as
+ * the consumer is done with them: the data is copied into one of bufferCount
+ * buffers owned by the log thread. Only if all of these wait to be written,
+ * the consumer waits for the log thread.
+ *
+ * LogWriter is LogFileWriter or anything with the same constructor and
+ * write(), close() and isDirectIO() methods.
+ */
+template<typename Device, typename LogWriter = LogFileWriter>
+class BasicRTLSDRIQSource
+{
+public:
+	enum class ReadMode
+	{
+		sync,
+		async
+	};
+
+	BasicRTLSDRIQSource(Device & device, size_t bufferSize, size_t bufferCount,
+		const std::string & logName, ReadMode readMode = ReadMode::sync,
+		const LogFileOptions & logOptions = LogFileOptions()):
+		m_device(device),
+		m_readMode(readMode),
+		m_bufferSize(bufferSize),
+		m_bufferCount(bufferCount),
+		m_freeBuffers(bufferCount),
+		m_recordedBuffers(bufferCount),
+		m_loggedBuffers(bufferCount),
+		m_logPool(bufferCount),
+		m_running(false)
+	{
+		if (m_readMode == ReadMode::sync)
+		{
+			// the buffers are owned by the source
+			m_storage.resize(bufferCount, std::vector<uint8_t>(bufferSize));
+			for (std::vector<uint8_t> & buffer: m_storage)
+				m_freeBuffers.tryPush(Buffer{buffer.data(), 0});
+		}
+
+		if (!logName.empty())
+		{
+			m_log = std::make_unique<LogWriter>(logName, logOptions);
+
+			if (m_readMode == ReadMode::async)
+			{
+				// copies of the device's buffers waiting to be written
+				m_logStorage.resize(bufferCount, std::vector<uint8_t>(bufferSize));
+				for (std::vector<uint8_t> & buffer: m_logStorage)
+					m_logPool.tryPush(Buffer{buffer.data(), 0});
+			}
+
+			m_logThread = std::thread(&BasicRTLSDRIQSource::logLoop, this);
+
+			std::cout << "Writing raw IQ log into '" << logName << "'"
+				<< (m_log->isDirectIO() ? " (direct I/O)." : ".") << std::endl;
+		}
+	}
+
+	~BasicRTLSDRIQSource()
+	{
+		/*
+		 * There is no consumer anymore, so no buffer is in use. The log
+		 * thread writes what it has got. (In the async mode, the device's
+		 * callback is still waiting for the buffers.)
+		 */
+		releaseCurrentBuffer();
+		if (m_logThread.joinable())
+		{
+			m_loggedBuffers.close();
+			m_logThread.join();
+		}
+
+		// let the device's callback return without waiting for a buffer
+		m_freeBuffers.close();
+
+		stop();
+	}
+
+	/**
+	 * Start the recording thread, optionally pin it to a CPU.
+	 */
+	void start(std::optional<unsigned> cpu = std::nullopt)
+	{
+		std::lock_guard<std::mutex> g(m_mutex);
+
+		if (m_running.load() || m_recordedBuffers.isClosed())
+			throw std::runtime_error("recording thread already started");
+
+		m_running.store(true);
+		m_thread = std::thread(&BasicRTLSDRIQSource::recordingLoop, this);
+
+		if (cpu)
+			setThreadAffinity(m_thread, *cpu);
+	}
+
+	/**
+	 * Stop recording. Blocks that have already been recorded can still be
+	 * obtained by getBlock(). The source can't be restarted.
+	 */
+	void stop()
+	{
+		std::lock_guard<std::mutex> g(m_mutex);
+
+		if (m_running.exchange(false))
+		{
+			if (m_readMode == ReadMode::sync)
+			{
+				// wake up the recording thread if it's waiting for a free buffer
+				m_freeBuffers.close();
+			}
+			else
+			{
+				/*
+				 * The free buffers queue can't be closed here: the device's
+				 * callback must not return before the consumer is done with
+				 * the buffer. Refuse any further buffers instead.
+				 */
+				m_recordedBuffers.close();
+				m_device.cancelAsync();
+			}
+		}
+
+		if (m_thread.joinable())
+			m_thread.join();
+
+		// let the consumer drain what has been recorded
+		m_recordedBuffers.close();
+	}
+
+	/**
+	 * Get the next block of recorded samples. The returned block is valid
+	 * until the next call to getBlock(). Returns std::nullopt if stopped
+	 * and there is no more data.
+	 */
+	std::optional<IQBlock> getBlock()
+	{
+		// the caller is done with the previous block
+		releaseCurrentBuffer();
+
+		std::optional<Buffer> buffer = m_recordedBuffers.pop();
+		if (!buffer)
+			return std::nullopt; // stopped and there is no more data
+
+		m_currentBuffer = *buffer;
+		assert(m_currentBuffer->size != 0);
+
+		// TODO: can rtl-sdr return an odd-sized buffer?
+		if (m_currentBuffer->size % 2 != 0)
+			throw std::runtime_error("size of data buffer must be even");
+
+		return IQBlock{m_currentBuffer->data, m_currentBuffer->size / 2};
+	}
+
+private:
+	/*
+	 * A buffer passed between the recording thread and the consumer. It's
+	 * either one of m_storage (sync mode) or a buffer owned by the device
+	 * (async mode).
+	 */
+	struct Buffer
+	{
+		uint8_t * data;
+		size_t size;
+	};
+
+	void recordingLoop()
+	{
+		if (m_readMode == ReadMode::sync)
+			readSyncLoop();
+		else
+			readAsync();
+
+		// no more data will come (e.g. the device has stopped streaming)
+		m_recordedBuffers.close();
+	}
+
+	void readSyncLoop()
+	{
+		while (m_running.load(std::memory_order_relaxed))
+		{
+			// wait for a free buffer to become available
+			std::optional<Buffer> buffer = m_freeBuffers.pop();
+			if (!buffer)
+				break; // stopped
+
+			// don't place empty buffers in recorded buffers
+			do
+				readBuffer(*buffer);
+			while (buffer->size == 0 && m_running.load(std::memory_order_relaxed));
+
+			if (buffer->size != 0)
+				m_recordedBuffers.push(std::move(*buffer));
+		}
+	}
+
+	void readBuffer(Buffer & buffer)
+	{
+		const size_t wasRead = m_device.readSync(buffer.data, m_bufferSize);
+		if (wasRead != m_bufferSize)
+			std::cout << "Lost data!" << std::endl;
+
+		buffer.size = wasRead;
+	}
+
+	void readAsync()
+	{
+		m_device.readAsync([this](uint8_t * data, size_t size) {
+			if (size == 0)
+				return;
+
+			// if stopped, the buffer is not passed on and the device can reuse it immediately
+			if (!m_recordedBuffers.push(Buffer{data, size}))
+				return;
+
+			// wait for the consumer to return the buffer, the device reuses it when this returns
+			m_freeBuffers.pop();
+		}, m_bufferCount, m_bufferSize);
+	}
+
+	void releaseCurrentBuffer()
+	{
+		// if stopped (in the sync mode), the buffer is simply dropped
+		if (m_currentBuffer)
+		{
+			if (!m_log)
+				m_freeBuffers.push(std::move(*m_currentBuffer));
+			else if (m_readMode == ReadMode::sync)
+				m_loggedBuffers.push(std::move(*m_currentBuffer));
+			else
+			{
+				// waits only if all the copies are still waiting to be written
+				std::optional<Buffer> copy = m_logPool.pop();
+				if (copy)
+				{
+					std::copy_n(m_currentBuffer->data, m_currentBuffer->size, copy->data);
+					copy->size = m_currentBuffer->size;
+					m_loggedBuffers.push(std::move(*copy));
+				}
+
+				m_freeBuffers.push(std::move(*m_currentBuffer));
+			}
+		}
+		m_currentBuffer.reset();
+	}
+
+	void logLoop()
+	{
+		bool logging = true;
+		while (std::optional<Buffer> buffer = m_loggedBuffers.pop())
+		{
+			if (logging)
+			{
+				try
+				{
+					m_log->write(buffer->data, buffer->size);
+				}
+				catch (const std::system_error & e)
+				{
+					// keep decoding, but don't make it worse by retrying
+					std::cerr << e.what() << ", not writing raw IQ log anymore." << std::endl;
+					logging = false;
+				}
+			}
+
+			if (m_readMode == ReadMode::sync)
+				m_freeBuffers.push(std::move(*buffer));
+			else
+				m_logPool.push(std::move(*buffer));
+		}
+
+		try
+		{
+			m_log->close();
+		}
+		catch (const std::system_error & e)
+		{
+			std::cerr << e.what() << std::endl;
+		}
+	}
+
+	Device & m_device;
+	const ReadMode m_readMode;
+	const size_t m_bufferSize;
+	const size_t m_bufferCount;
+
+	// buffers owned by the source, used in the sync mode
+	std::vector<std::vector<uint8_t>> m_storage;
+
+	// buffers owned by the log thread, used in the async mode
+	std::vector<std::vector<uint8_t>> m_logStorage;
+
+	/*
+	 * Buffers are handed between the recording thread and the consumer (the
+	 * thread calling getBlock()) via lock-free SPSC queues:
+	 * m_freeBuffers: consumer (or log thread in the sync mode) -> recording thread
+	 * m_recordedBuffers: recording thread -> consumer
+	 * m_loggedBuffers: consumer -> log thread (only if logging)
+	 * m_logPool: log thread -> consumer (only if logging in the async mode)
+	 * Each queue has room for all buffers, so a push never has to wait.
+	 */
+	SPSCQueue<Buffer> m_freeBuffers;
+	SPSCQueue<Buffer> m_recordedBuffers;
+	SPSCQueue<Buffer> m_loggedBuffers;
+	SPSCQueue<Buffer> m_logPool;
+	std::atomic<bool> m_running;
+
+	// mutex serializing start() and stop()
+	std::mutex m_mutex;
+
+	// the buffer last returned by getBlock(), only accessed by the consumer
+	std::optional<Buffer> m_currentBuffer;
+
+	std::thread m_thread;
+
+	std::unique_ptr<LogWriter> m_log;
+	std::thread m_logThread;
+};
+
+} // namespace rts
+
+#endif // RTS_BASIC_RTLSDR_IQ_SOURCE_H
@@ -0,0 +1,176 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_CIC_DECIMATOR_H
+#define RTS_CIC_DECIMATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <array>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#include "IQBlock.h"
+
+namespace rts
+{
+
+/**
+ * @brief Reduce the sample rate of an IQ source by an integer factor.
+ *
+ * This is an IQ source itself (see IQBlock.h) that reads blocks from IQSource
+ * and passes them through a CIC (cascaded integrator-comb) decimator of the
+ * given order: each of the I and Q channels is filtered by ORDER moving sums
+ * of decimation samples and every decimation-th sample is kept. The result is
+ * divided by the gain of the filter (decimation^ORDER) and rounded, so the
+ * output is again in the raw rtl-sdr format and it can be fed to OOKDecoder.
+ *
+ * The moving sums also act as the channel filter: the signal is expected
+ * to be (close to) the center frequency. With decimation 13, the 2.6 MS/s of
+ * the rtl-sdr become 200 kS/s and the first null of the filter is at
+ * 200 kHz.
+ *
+ * All arithmetic is done in uint32_t, which is allowed to wrap around: the
+ * integrators overflow, but the combs' output is exact as long as the
+ * filter's output fits (which is checked by the constructor). With ORDER 2
+ * this limits decimation to 4095.
+ *
+ * If decimation is 1, the blocks are passed through unmodified.
+ */
+template<typename IQSource, size_t ORDER = 2>
+class CICDecimator
+{
+public:
+	static_assert(ORDER > 0, "CIC order must be positive");
+
+	CICDecimator(IQSource & iqSource, size_t decimation):
+		m_iqSource(iqSource),
+		m_decimation(decimation),
+		m_gain(gain(decimation)),
+		m_phase(0),
+		m_integrators{},
+		m_combs{}
+	{}
+
+	size_t getDecimation() const
+	{
+		return m_decimation;
+	}
+
+	/**
+	 * Get the next block of decimated samples. The returned block is valid
+	 * until the next call to getBlock(). Returns std::nullopt if there is
+	 * no more data.
+	 */
+	std::optional<IQBlock> getBlock()
+	{
+		if (m_decimation == 1)
+			return m_iqSource.getBlock();
+
+		while (true)
+		{
+			const std::optional<IQBlock> block = m_iqSource.getBlock();
+			if (!block)
+				return std::nullopt;
+
+			const size_t size = decimate(*block);
+
+			// a short block might not complete any output sample
+			if (size > 0)
+				return IQBlock{m_output.data(), size};
+		}
+	}
+
+private:
+	// the channels of an IQ sample
+	static constexpr size_t CHANNELS = 2;
+
+	static uint32_t gain(size_t decimation)
+	{
+		if (decimation == 0)
+			throw std::runtime_error("decimation must be positive");
+
+		// the output of the filter, up to 255 * decimation^ORDER, must fit into uint32_t, even when rounded
+		uint64_t g = 1;
+		for (size_t i = 0; i < ORDER; i++)
+		{
+			g *= decimation;
+			if (g * 256 > std::numeric_limits<uint32_t>::max())
+				throw std::runtime_error(std::string("decimation ") + std::to_string(decimation) + " is too large");
+		}
+
+		return static_cast<uint32_t>(g);
+	}
+
+	size_t decimate(const IQBlock & block)
+	{
+		m_output.resize(CHANNELS * ((m_phase + block.size) / m_decimation));
+
+		uint8_t * out = m_output.data();
+		for (size_t k = 0; k < CHANNELS * block.size; k += CHANNELS)
+		{
+			for (size_t c = 0; c < CHANNELS; c++)
+			{
+				uint32_t x = block.data[k + c];
+				for (size_t i = 0; i < ORDER; i++)
+					x = m_integrators[c][i] += x;
+			}
+
+			if (++m_phase == m_decimation)
+			{
+				m_phase = 0;
+
+				for (size_t c = 0; c < CHANNELS; c++)
+				{
+					uint32_t x = m_integrators[c][ORDER - 1];
+					for (size_t i = 0; i < ORDER; i++)
+					{
+						const uint32_t y = x - m_combs[c][i];
+						m_combs[c][i] = x;
+						x = y;
+					}
+
+					// x is the sum of decimation^ORDER samples (with weights), round the average
+					*out++ = static_cast<uint8_t>((x + m_gain / 2) / m_gain);
+				}
+			}
+		}
+
+		return (out - m_output.data()) / CHANNELS;
+	}
+
+	IQSource & m_iqSource;
+	const size_t m_decimation;
+	const uint32_t m_gain;
+
+	// number of input samples since the last output sample
+	size_t m_phase;
+
+	// per channel state: integrators (at the input rate) and the delayed values of the combs (at the output rate)
+	std::array<std::array<uint32_t, ORDER>, CHANNELS> m_integrators;
+	std::array<std::array<uint32_t, ORDER>, CHANNELS> m_combs;
+
+	std::vector<uint8_t> m_output;
+};
+
+} // namespace rts
+
+#endif // RTS_CIC_DECIMATOR_H
@@ -19,33 +19,48 @@
 #ifndef RTS_FILTER_H
 #define RTS_FILTER_H
 
-#include <vector>
+#include <cstddef>
+#include <array>
 #include <stdexcept>
 
-#include <boost/circular_buffer.hpp>
-
 namespace rts
 {
 
+// coefficients of a filter, see Filter for their meaning
+template<size_t NA, size_t NB>
+struct FilterCoefficients
+{
+	std::array<float, NA> a;
+	std::array<float, NB> b;
+};
+
+typedef FilterCoefficients<2, 2> FirstOrderFilterCoefficients;
+
+/**
+ * @brief IIR filter with NA coefficients a and NB coefficients b.
+ *
+ * The sizes are known at compile time and the history is kept in arrays,
+ * so the recurrence can be fully unrolled.
+ */
+template<size_t NA, size_t NB>
 class Filter
 {
 public:
-	Filter(std::vector<float> && a, std::vector<float> && b):
-		m_a(std::move(a)),
-		m_b(std::move(b)),
-		m_pastOutputs(m_a.size(), 0.0f),
-		m_pastInputs(m_b.size(), 0.0f)
-	{
-		if (m_a.empty() || m_b.empty())
-			throw std::runtime_error("invalid filter parameters!");
-	}
+	static_assert(NA > 0 && NB > 0, "invalid filter parameters!");
 
-	float operator << (float f)
-	{
-		m_pastInputs.push_back(f);
+	constexpr Filter(const std::array<float, NA> & a, const std::array<float, NB> & b):
+		m_a(a),
+		m_b(b),
+		m_pastOutputs(),
+		m_pastInputs()
+	{}
 
-		float y = 0.0f;
+	constexpr Filter(const FilterCoefficients<NA, NB> & coefficients):
+		Filter(coefficients.a, coefficients.b)
+	{}
 
+	float operator << (float f)
+	{
 		/*
 		 * This should work exactly like Octave's filter(), that is: solve y_k from:
 		 *
@@ -61,34 +76,176 @@ public:
 		 *
 		 *   y_k = 1/a_0 [ sum_{i=0}^{N_b-1} b_i*x{k-i} - sum_{i=1}^{N_a-1} a_i*y_{k-i} ]
 		 *
-		 * and this is what the code below calculates.
+		 * and this is what the code below calculates. m_pastInputs[i] is
+		 * x_{k-i}, m_pastOutputs[i] is y_{k-1-i}.
 		 */
+		for (size_t i = NB - 1; i > 0; i--)
+			m_pastInputs[i] = m_pastInputs[i - 1];
+		m_pastInputs[0] = f;
+
+		float y = 0.0f;
 
-		// the x part
-		for (size_t i = 0; i < m_b.size(); i++)
+		// the x part, the oldest first
+		for (size_t i = NB; i-- > 0; )
 			y += m_pastInputs[i] * m_b[i];
 
 		// the y part (with a -), skipping i == 0 obviously
-		for (size_t i = 1; i < m_a.size(); i++)
-			y -= m_pastOutputs[i] * m_a[i];
+		for (size_t i = 1; i < NA; i++)
+			y -= m_pastOutputs[i - 1] * m_a[i];
 
 		// account for a_0
 		y /= m_a[0];
 
-		// store y_0 for next iteration
-		m_pastOutputs.push_back(y);
+		// store y_k for next iteration (there are no past outputs for a FIR filter)
+		if constexpr (NA > 1)
+		{
+			for (size_t i = NA - 2; i > 0; i--)
+				m_pastOutputs[i] = m_pastOutputs[i - 1];
+			m_pastOutputs[0] = y;
+		}
 
 		return y;
 	}
 
 private:
-	const std::vector<float> m_a;
-	const std::vector<float> m_b;
+	const std::array<float, NA> m_a;
+	const std::array<float, NB> m_b;
+
+	std::array<float, NA> m_pastOutputs; // Y, only NA - 1 are used
+	std::array<float, NB> m_pastInputs; // X
+};
+
+template<size_t NA, size_t NB>
+Filter(const FilterCoefficients<NA, NB> &) -> Filter<NA, NB>;
+
+template<size_t NA, size_t NB>
+Filter(const std::array<float, NA> &, const std::array<float, NB> &) -> Filter<NA, NB>;
+
+/**
+ * @brief Design of Butterworth low-pass filters, usable at compile time.
+ *
+ * The result is the same as Octave's:
+ *
+ *   [B, A] = butter(ORDER, cutoff / (sampleRate/2));
+ *
+ * That is, the analog prototype is transformed by the bilinear transform with
+ * the cut-off frequency pre-warped: K = tan(pi*cutoff/sampleRate). The
+ * prototype is split into sections: s^2 + 2*sin(pi*(2k + 1)/(2*ORDER))*s + 1
+ * for each pair of poles and s + 1 for the real pole of odd orders.
+ * The sections are transformed separately and multiplied together.
+ *
+ * The computation is done in double, std::tan() etc. are not constexpr in
+ * C++17, so there are replacements (Taylor series, accurate for the range
+ * needed here, i.e. [0, pi/2]).
+ */
+class ButterworthDesign
+{
+public:
+	template<size_t ORDER>
+	static constexpr FilterCoefficients<ORDER + 1, ORDER + 1> lowPass(double cutoff, double sampleRate)
+	{
+		static_assert(ORDER > 0, "order must be positive");
+
+		if (!(cutoff > 0 && cutoff < sampleRate / 2))
+			throw std::runtime_error("cut-off frequency must be between 0 and half of the sample rate");
+
+		const double k = tan(PI * cutoff / sampleRate);
+
+		std::array<double, ORDER + 1> a{};
+		std::array<double, ORDER + 1> b{};
+		a[0] = 1;
+		b[0] = 1;
+		size_t order = 0;
+
+		if (ORDER % 2 == 1)
+		{
+			// 1/(s + 1) -> K(1 + z^-1) / ((1 + K) + (K - 1)z^-1)
+			multiply(a, order, {1 + k, k - 1, 0});
+			multiply(b, order, {k, k, 0});
+			order += 1;
+		}
+
+		for (size_t i = 0; i < ORDER / 2; i++)
+		{
+			// 1/(s^2 + c*s + 1) -> K^2(1 + z^-1)^2 / ((1 + cK + K^2) + 2(K^2 - 1)z^-1 + (1 - cK + K^2)z^-2)
+			const double c = 2 * sin(PI * (2*i + 1) / (2*ORDER));
+			multiply(a, order, {1 + c*k + k*k, 2*(k*k - 1), 1 - c*k + k*k});
+			multiply(b, order, {k*k, 2*k*k, k*k});
+			order += 2;
+		}
+
+		FilterCoefficients<ORDER + 1, ORDER + 1> result{};
+		for (size_t i = 0; i <= ORDER; i++)
+		{
+			result.a[i] = static_cast<float>(a[i] / a[0]);
+			result.b[i] = static_cast<float>(b[i] / a[0]);
+		}
+		result.a[0] = 1.0f;
+
+		return result;
+	}
+
+private:
+	static constexpr double PI = 3.14159265358979323846;
+
+	// p = p * section (a polynomial in z^-1, p has degree order)
+	template<size_t N>
+	static constexpr void multiply(std::array<double, N> & p, size_t order, const std::array<double, 3> & section)
+	{
+		std::array<double, N> result{};
+		for (size_t i = 0; i <= order; i++)
+			for (size_t j = 0; j < section.size() && i + j < N; j++)
+				result[i + j] += p[i] * section[j];
+
+		p = result;
+	}
 
-	boost::circular_buffer<float> m_pastOutputs; // Y
-	boost::circular_buffer<float> m_pastInputs; // X
+	// for 0 <= x <= pi/2
+	static constexpr double sin(double x)
+	{
+		double term = x;
+		double sum = x;
+		for (int n = 1; n < TAYLOR_TERMS; n++)
+		{
+			term *= -x * x / ((2*n) * (2*n + 1));
+			sum += term;
+		}
+
+		return sum;
+	}
+
+	// for 0 <= x <= pi/2
+	static constexpr double cos(double x)
+	{
+		double term = 1;
+		double sum = 1;
+		for (int n = 1; n < TAYLOR_TERMS; n++)
+		{
+			term *= -x * x / ((2*n - 1) * (2*n));
+			sum += term;
+		}
+
+		return sum;
+	}
+
+	static constexpr double tan(double x)
+	{
+		return sin(x) / cos(x);
+	}
+
+	// the terms for x <= pi/2 are below 1e-30 from here on
+	static constexpr int TAYLOR_TERMS = 30;
 };
 
+/**
+ * Design a first order Butterworth low-pass filter (see ButterworthDesign).
+ * This gives b_0 = b_1 = K/(1 + K), a_0 = 1, a_1 = (K - 1)/(K + 1).
+ */
+constexpr FirstOrderFilterCoefficients designLowPassFilter(double cutoff, double sampleRate)
+{
+	return ButterworthDesign::lowPass<1>(cutoff, sampleRate);
+}
+
 } // namespace rts
 
 #endif // RTS_FILTER_H
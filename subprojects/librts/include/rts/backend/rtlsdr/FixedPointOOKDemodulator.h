@@ -0,0 +1,283 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_FIXED_POINT_OOK_DEMODULATOR_H
+#define RTS_FIXED_POINT_OOK_DEMODULATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#include <array>
+#include <algorithm>
+#include <stdexcept>
+
+#include "IQMagnitude.h"
+
+namespace rts
+{
+
+/**
+ * @brief Integer-only variant of OOKDemodulator.
+ *
+ * This does the same as OOKDemodulator (magnitude, first order IIR low-pass,
+ * threshold) and it has the same interface, so it can be used as the
+ * Demodulator of OOKDecoder. But all the per sample arithmetic is done with
+ * integers, which is much faster on CPUs with a weak (or no) FPU, like the
+ * ARM11 of Raspberry Pi Zero and 1.
+ *
+ * The signal is represented in Q15: 1.0 (the magnitude of a normalized
+ * sample, see RTLSDRBufferReader) is 32768. The magnitude of a sample is
+ * looked up in a table indexed by I^2 + Q^2 (I, Q being the raw values minus
+ * 128), that is sqrt(I^2 + Q^2) / 128 * 32768. The filter coefficients and the
+ * threshold are rounded to Q15 too.
+ *
+ * The result is not bit-identical to OOKDemodulator: the rounding errors
+ * shift the output of the filter by a few LSBs (~1e-4). A transition of the
+ * output can move by a sample if the filter's output crosses the threshold
+ * slowly.
+ *
+ * Quiet segments of the signal are skipped the same way as by OOKDemodulator
+ * (with the same caveat: the state of the filter after a skipped segment is
+ * only equivalent within rounding).
+ */
+class FixedPointOOKDemodulator
+{
+public:
+	/**
+	 * Create the demodulator for a filter given by a = {a_0, a_1}, b = {b_0, b_1}
+	 * (see Filter for the meaning of the coefficients).
+	 */
+	FixedPointOOKDemodulator(const std::array<float, 2> & a, const std::array<float, 2> & b, float threshold):
+		m_b0(toQ15(b[0] / a[0])),
+		m_b1(toQ15(b[1] / a[0])),
+		m_a1(toQ15(a[1] / a[0])),
+		m_threshold(toQ15(threshold)),
+		m_lastInput(0),
+		m_lastOutput(0),
+		m_settlingSamples(getSettlingSamples(std::abs(m_a1)))
+	{
+		/*
+		 * The accumulator is int32_t. The magnitude (and thus the output of a
+		 * stable filter with unity gain) is at most MAX_MAGNITUDE.
+		 */
+		const int64_t maxAccumulator = (static_cast<int64_t>(std::abs(m_b0)) + std::abs(m_b1) + std::abs(m_a1)) * MAX_MAGNITUDE + ROUNDING;
+		if (maxAccumulator > INT32_MAX)
+			throw std::runtime_error("filter coefficients out of range for the fixed point demodulator");
+	}
+
+	/**
+	 * Demodulate count samples from iq (2*count bytes) and store the bits into
+	 * bits which must have room for (count + 63) / 64 words.
+	 */
+	void process(const uint8_t * iq, size_t count, uint64_t * bits)
+	{
+		while (count > 0)
+		{
+			const size_t n = count < GATE_SIZE ? count : GATE_SIZE;
+			const size_t words = (n + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+			if (isQuiet(iq, n))
+			{
+				settle(iq, n);
+				std::fill_n(bits, words, 0);
+			}
+			else
+				processSegment(iq, n, bits);
+
+			bits += words;
+			iq += 2*n;
+			count -= n;
+		}
+	}
+
+	static constexpr size_t BITS_PER_WORD = 64;
+
+	// samples checked at once for being quiet, a multiple of BITS_PER_WORD
+	static constexpr size_t GATE_SIZE = 4096;
+
+	// number of fractional bits
+	static constexpr int Q = 15;
+
+	// the magnitude of each possible raw sample in Q15, indexed by I^2 + Q^2
+	typedef std::array<uint16_t, 2*128*128 + 1> MagnitudeTable;
+
+	static const MagnitudeTable & getMagnitudeTable()
+	{
+		static const MagnitudeTable table = makeMagnitudeTable();
+		return table;
+	}
+
+private:
+	void processSegment(const uint8_t * iq, size_t count, uint64_t * bits)
+	{
+		const MagnitudeTable & table = getMagnitudeTable();
+
+		int32_t x1 = m_lastInput;
+		int32_t y1 = m_lastOutput;
+
+		while (count > 0)
+		{
+			const size_t n = count < BITS_PER_WORD ? count : BITS_PER_WORD;
+			uint64_t word = 0;
+
+			for (size_t k = 0; k < n; k++)
+			{
+				const int32_t i = static_cast<int32_t>(iq[2*k]) - 128;
+				const int32_t q = static_cast<int32_t>(iq[2*k + 1]) - 128;
+				const int32_t x = table[i*i + q*q];
+
+				// y_k = b_0*x_k + b_1*x_{k-1} - a_1*y_{k-1}, a_0 == 1
+				const int32_t y = (m_b1 * x1 + m_b0 * x - m_a1 * y1 + ROUNDING) >> Q;
+
+				word |= static_cast<uint64_t>(y >= m_threshold) << k;
+
+				x1 = x;
+				y1 = y;
+			}
+
+			*bits++ = word;
+			iq += 2*n;
+			count -= n;
+		}
+
+		m_lastInput = x1;
+		m_lastOutput = y1;
+	}
+
+	/*
+	 * Can the output of the filter reach the threshold within the count
+	 * samples? See OOKDemodulator::isQuiet(), this is the same in Q15.
+	 */
+	bool isQuiet(const uint8_t * iq, size_t count) const
+	{
+		if (m_settlingSamples == 0 || count < 2*m_settlingSamples)
+			return false;
+
+		// the table is monotonic and I^2 + Q^2 <= 2*deviation^2
+		const uint32_t deviation = IQPeak::maxDeviation(iq, count);
+		const int64_t input = std::max<int64_t>(getMagnitudeTable()[2*deviation*deviation], std::abs(m_lastInput));
+
+		const int64_t gain = std::abs(m_b0) + std::abs(m_b1);
+		const int64_t pole = std::abs(m_a1);
+		const int64_t steady = (gain * input + ROUNDING + ((1 << Q) - pole) - 1) / ((1 << Q) - pole);
+
+		return std::max<int64_t>(std::abs(m_lastOutput), steady) < m_threshold;
+	}
+
+	// bring the filter into the state after the count samples, their output is not needed
+	void settle(const uint8_t * iq, size_t count)
+	{
+		const MagnitudeTable & table = getMagnitudeTable();
+
+		// start from the steady state for the first input
+		const uint8_t * tail = iq + 2*(count - m_settlingSamples);
+		int32_t x1 = magnitude(table, tail[0], tail[1]);
+		int32_t y1 = x1;
+
+		for (size_t k = 1; k < m_settlingSamples; k++)
+		{
+			const int32_t x = magnitude(table, tail[2*k], tail[2*k + 1]);
+			y1 = (m_b1 * x1 + m_b0 * x - m_a1 * y1 + ROUNDING) >> Q;
+			x1 = x;
+		}
+
+		m_lastInput = x1;
+		m_lastOutput = y1;
+	}
+
+	static int32_t magnitude(const MagnitudeTable & table, uint8_t bi, uint8_t bq)
+	{
+		const int32_t i = static_cast<int32_t>(bi) - 128;
+		const int32_t q = static_cast<int32_t>(bq) - 128;
+		return table[i*i + q*q];
+	}
+
+	// see OOKDemodulator::getSettlingSamples(), pole is in Q15
+	static size_t getSettlingSamples(int32_t pole)
+	{
+		if (pole == 0)
+			return 2;
+		if (pole >= (1 << Q))
+			return 0;
+
+		const double n = std::ceil(std::log(SETTLING_ERROR) / std::log(static_cast<double>(pole) / (1 << Q))) + 1;
+		return n <= GATE_SIZE / 8 ? static_cast<size_t>(n) : 0;
+	}
+
+	// far below the resolution of Q15
+	static constexpr double SETTLING_ERROR = 1e-12;
+
+	static constexpr int32_t ROUNDING = 1 << (Q - 1);
+
+	// sqrt(2*128^2) / 128 in Q15
+	static constexpr int32_t MAX_MAGNITUDE = 46341;
+
+	static int32_t toQ15(float value)
+	{
+		return static_cast<int32_t>(std::lround(value * (1 << Q)));
+	}
+
+	static MagnitudeTable makeMagnitudeTable()
+	{
+		MagnitudeTable table;
+		for (uint32_t s = 0; s < table.size(); s++)
+		{
+			// sqrt(s) / 128 * 2^15 == sqrt(s * 2^16), rounded to nearest
+			const uint32_t n = s << 16;
+			const uint32_t r = isqrt(n);
+			table[s] = static_cast<uint16_t>(n - r*r > r ? r + 1 : r);
+		}
+
+		return table;
+	}
+
+	// floor(sqrt(n)), bit by bit
+	static uint32_t isqrt(uint32_t n)
+	{
+		uint32_t result = 0;
+		for (uint32_t bit = 1u << 30; bit != 0; bit >>= 2)
+		{
+			if (n >= result + bit)
+			{
+				n -= result + bit;
+				result = (result >> 1) + bit;
+			}
+			else
+				result >>= 1;
+		}
+
+		return result;
+	}
+
+	const int32_t m_b0;
+	const int32_t m_b1;
+	const int32_t m_a1;
+	const int32_t m_threshold;
+
+	// filter state: x_{k-1} and y_{k-1}
+	int32_t m_lastInput;
+	int32_t m_lastOutput;
+
+	// used to skip quiet segments, see isQuiet()
+	const size_t m_settlingSamples;
+};
+
+} // namespace rts
+
+#endif // RTS_FIXED_POINT_OOK_DEMODULATOR_H
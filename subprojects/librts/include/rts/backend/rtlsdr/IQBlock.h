@@ -0,0 +1,49 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_IQ_BLOCK_H
+#define RTS_IQ_BLOCK_H
+
+#include <cstddef>
+#include <cstdint>
+
+namespace rts
+{
+
+/**
+ * @brief A block of raw IQ samples as produced by rtl-sdr.
+ *
+ * The block consists of size pairs of unsigned bytes (I, Q). The data is
+ * owned by the source that returned the block. It stays valid until the
+ * next call of the source's getBlock() or until the source is destroyed.
+ *
+ * An IQ source is any class providing:
+ *
+ *   std::optional<IQBlock> getBlock();
+ *
+ * that returns std::nullopt when there is no more data.
+ */
+struct IQBlock
+{
+	const uint8_t * data;
+	size_t size; // number of pairs (i, q) in the block
+};
+
+} // namespace rts
+
+#endif // RTS_IQ_BLOCK_H
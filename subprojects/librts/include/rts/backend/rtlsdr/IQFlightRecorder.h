@@ -0,0 +1,337 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_IQ_FLIGHT_RECORDER_H
+#define RTS_IQ_FLIGHT_RECORDER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <string>
+#include <thread>
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <utility>
+#include <system_error>
+#include <iostream>
+#include <iomanip>
+
+#include "../../Clock.h"
+#include "../../SPSCQueue.h"
+#include "../../LogFileWriter.h"
+#include "../../SomfyFrameEvent.h"
+#include "../../SomfyFramePrinter.h"
+#include "IQBlock.h"
+
+namespace rts
+{
+
+/**
+ * @brief IQ source that keeps the last few seconds of raw samples in memory
+ * and saves them only around interesting events.
+ *
+ * The blocks of IQSource are passed through unchanged and copied into a ring
+ * buffer. When trigger() is called (e.g. by FlightRecorderTrigger when
+ * SomfyDecoder detects a frame), the samples from preTrigger before the event
+ * until postTrigger after it are written into a new file, fileNamePrefix-N.iq
+ * (the same format as the raw IQ log). Overlapping windows are merged into
+ * one file. The files are written by a separate thread.
+ *
+ * The time of an event is the time stamp of OOKDecoder, i.e. the time since
+ * the first sample that passed through this source. The decoder lags behind
+ * the reading, but not more than MAX_LATENCY. So a window is saved MAX_LATENCY
+ * after its end, when no more events can extend it.
+ *
+ * If fileNamePrefix is empty, the recorder is disabled: the blocks are just
+ * passed through and trigger() does nothing.
+ *
+ * trigger() can be called from another thread than getBlock() (e.g. in the
+ * pipelined mode).
+ */
+template<typename IQSource>
+class IQFlightRecorder
+{
+public:
+	IQFlightRecorder(IQSource & source, size_t sampleRate, const std::string & fileNamePrefix,
+		Clock::duration preTrigger, Clock::duration postTrigger):
+		m_source(source),
+		m_sampleRate(sampleRate),
+		m_fileNamePrefix(fileNamePrefix),
+		m_preTrigger(toSamples(preTrigger)),
+		m_postTrigger(toSamples(postTrigger)),
+		m_maxLatency(toSamples(MAX_LATENCY)),
+		m_ringSize(m_preTrigger + m_postTrigger + 2*m_maxLatency),
+		m_position(0),
+		m_capturedUntil(0),
+		m_captures(CAPTURE_QUEUE_CAPACITY),
+		m_captureCount(0)
+	{
+		if (isEnabled())
+		{
+			m_ring.resize(2*m_ringSize);
+			m_writerThread = std::thread(&IQFlightRecorder::writerLoop, this);
+		}
+	}
+
+	IQFlightRecorder(const IQFlightRecorder &) = delete;
+	IQFlightRecorder & operator=(const IQFlightRecorder &) = delete;
+
+	~IQFlightRecorder()
+	{
+		if (!isEnabled())
+			return;
+
+		{
+			// save what there is for the events near the end of data
+			std::lock_guard<std::mutex> g(m_mutex);
+			for (const Window & w: m_pending)
+				capture(w.first, std::min(w.second, m_position));
+		}
+
+		m_captures.close();
+		m_writerThread.join();
+	}
+
+	std::optional<IQBlock> getBlock()
+	{
+		std::optional<IQBlock> block = m_source.getBlock();
+		if (!block || !isEnabled())
+			return block;
+
+		std::lock_guard<std::mutex> g(m_mutex);
+
+		// e.g. a long burst of events: save what there is before it's overwritten
+		while (!m_pending.empty() && m_position + block->size > m_pending.front().first + m_ringSize)
+		{
+			Window & w = m_pending.front();
+			const uint64_t to = std::min(w.second, m_position);
+			capture(w.first, to);
+
+			if (to < w.second)
+			{
+				// the rest is saved into another file
+				w.first = to;
+				break;
+			}
+			m_pending.pop_front();
+		}
+
+		append(*block);
+
+		// no more events can extend these windows
+		while (!m_pending.empty() && m_position >= m_pending.front().second + m_maxLatency)
+		{
+			capture(m_pending.front().first, m_pending.front().second);
+			m_pending.pop_front();
+		}
+
+		return block;
+	}
+
+	/**
+	 * Save the samples around the given time.
+	 */
+	void trigger(Clock::time_point time)
+	{
+		if (!isEnabled())
+			return;
+
+		const uint64_t sample = toSamples(time.time_since_epoch());
+		std::lock_guard<std::mutex> g(m_mutex);
+
+		// don't save anything twice
+		const uint64_t from = std::max(sample - std::min(sample, m_preTrigger), m_capturedUntil);
+		const uint64_t to = sample + m_postTrigger;
+		if (from >= to)
+			return;
+
+		// merge overlapping windows
+		if (!m_pending.empty() && from <= m_pending.back().second)
+		{
+			m_pending.back().first = std::min(m_pending.back().first, from);
+			m_pending.back().second = std::max(m_pending.back().second, to);
+		}
+		else
+			m_pending.emplace_back(from, to);
+	}
+
+	bool isEnabled() const
+	{
+		return !m_fileNamePrefix.empty();
+	}
+
+	// number of files written so far
+	size_t getCaptureCount() const
+	{
+		std::lock_guard<std::mutex> g(m_mutex);
+		return m_captureCount;
+	}
+
+	// the name of the n-th file
+	std::string getCaptureFileName(size_t n) const
+	{
+		return m_fileNamePrefix + "-" + std::to_string(n) + ".iq";
+	}
+
+	// the decoder can't lag behind the reading more than this
+	static constexpr Clock::duration MAX_LATENCY = std::chrono::seconds(1);
+
+private:
+	// samples [first, second)
+	typedef std::pair<uint64_t, uint64_t> Window;
+
+	// samples to be written into a file
+	struct Capture
+	{
+		uint64_t firstSample;
+		std::vector<uint8_t> data;
+	};
+
+	static constexpr size_t CAPTURE_QUEUE_CAPACITY = 8;
+
+	uint64_t toSamples(Clock::duration duration) const
+	{
+		return sampleCount(duration, m_sampleRate);
+	}
+
+	void append(const IQBlock & block)
+	{
+		// only the last m_ringSize samples of a huge block fit in
+		const size_t skip = block.size > m_ringSize ? block.size - m_ringSize : 0;
+		m_position += skip;
+
+		for (size_t i = skip; i < block.size; )
+		{
+			const size_t offset = m_position % m_ringSize;
+			const size_t count = std::min(block.size - i, m_ringSize - offset);
+			std::copy_n(block.data + 2*i, 2*count, m_ring.begin() + 2*offset);
+			m_position += count;
+			i += count;
+		}
+	}
+
+	// pass the samples [from, to) to the writer thread (the ones still in the ring)
+	void capture(uint64_t from, uint64_t to)
+	{
+		from = std::max(from, m_position - std::min(m_position, m_ringSize));
+		if (from >= to)
+			return;
+
+		Capture c{from, std::vector<uint8_t>(2*(to - from))};
+		for (uint64_t i = from; i < to; )
+		{
+			const size_t offset = i % m_ringSize;
+			const size_t count = std::min<uint64_t>(to - i, m_ringSize - offset);
+			std::copy_n(m_ring.begin() + 2*offset, 2*count, c.data.begin() + 2*(i - from));
+			i += count;
+		}
+
+		m_capturedUntil = to;
+		if (m_captures.tryPush(std::move(c)))
+			m_captureCount++;
+		else
+			std::cerr << "Flight recorder: the writer can't keep up, dropping samples." << std::endl;
+	}
+
+	void writerLoop()
+	{
+		size_t n = 0;
+		while (std::optional<Capture> c = m_captures.pop())
+		{
+			const std::string fileName = getCaptureFileName(n++);
+			try
+			{
+				LogFileWriter writer(fileName);
+				writer.write(c->data.data(), c->data.size());
+				writer.close();
+
+				std::cout << "Flight recorder: saved " << std::fixed << std::setprecision(3)
+					<< static_cast<double>(c->data.size() / 2) / m_sampleRate << " s from "
+					<< static_cast<double>(c->firstSample) / m_sampleRate << " s into '"
+					<< fileName << "'." << std::defaultfloat << std::endl;
+			}
+			catch (const std::system_error & e)
+			{
+				std::cerr << "Flight recorder: " << e.what() << std::endl;
+			}
+		}
+	}
+
+	IQSource & m_source;
+	const size_t m_sampleRate;
+	const std::string m_fileNamePrefix;
+
+	// in samples
+	const uint64_t m_preTrigger;
+	const uint64_t m_postTrigger;
+	const uint64_t m_maxLatency;
+	const size_t m_ringSize;
+
+	// the last m_ringSize samples, sample i is at 2*(i % m_ringSize)
+	std::vector<uint8_t> m_ring;
+
+	// protects the members below, getBlock() and trigger() can run in different threads
+	mutable std::mutex m_mutex;
+
+	// number of samples passed through
+	uint64_t m_position;
+
+	// windows to be saved, in the order of time
+	std::deque<Window> m_pending;
+
+	// samples before this have been saved already
+	uint64_t m_capturedUntil;
+
+	// getBlock() -> writer thread
+	SPSCQueue<Capture> m_captures;
+	size_t m_captureCount;
+	std::thread m_writerThread;
+};
+
+/**
+ * @brief SomfyDecoder listener that triggers an IQFlightRecorder when a frame
+ * is detected or can't be decoded, and passes the events on to Listener.
+ */
+template<typename Recorder, typename Listener = SomfyFramePrinter>
+class FlightRecorderTrigger
+{
+public:
+	FlightRecorderTrigger(Recorder & recorder, Listener listener = Listener()):
+		m_recorder(&recorder),
+		m_listener(std::move(listener))
+	{}
+
+	void onEvent(const SomfyFrameEvent & event)
+	{
+		if (event.type != SomfyFrameEvent::Type::frameDecoded)
+			m_recorder->trigger(event.time);
+
+		m_listener.onEvent(event);
+	}
+
+private:
+	Recorder * m_recorder;
+	Listener m_listener;
+};
+
+} // namespace rts
+
+#endif // RTS_IQ_FLIGHT_RECORDER_H
@@ -0,0 +1,221 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_IQ_MAGNITUDE_H
+#define RTS_IQ_MAGNITUDE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+	#include <immintrin.h>
+#elif defined(__ARM_NEON)
+	#include <arm_neon.h>
+#endif
+
+#include "RTLSDRBufferReader.h"
+
+namespace rts
+{
+
+/*
+ * Front ends that compute the magnitudes of n raw rtl-sdr samples (2*n bytes)
+ * for OOKDemodulator.
+ *
+ * The samples are normalized as (b - 128) / 128 (see RTLSDRBufferReader).
+ * So abs(i + jq) == sqrt(I^2 + Q^2) / 128 where I = b_i - 128, Q = b_q - 128.
+ * I^2 + Q^2 <= 32768 is exactly representable as float, sqrt is correctly
+ * rounded and scaling by a power of two is exact too. So all front ends
+ * produce bit-identical results, the same as std::abs(std::complex<float>).
+ */
+
+struct ScalarMagnitude
+{
+	static void compute(const uint8_t * iq, size_t n, float * out)
+	{
+		for (size_t k = 0; k < n; k++)
+			out[k] = magnitude(iq[2*k], iq[2*k + 1]);
+	}
+
+	static float magnitude(uint8_t bi, uint8_t bq)
+	{
+		const int32_t i = static_cast<int32_t>(bi) - 128;
+		const int32_t q = static_cast<int32_t>(bq) - 128;
+		return std::sqrt(static_cast<float>(i*i + q*q)) * SCALE;
+	}
+
+	static constexpr float SCALE = 1.0f / 128.0f;
+};
+
+// uses AVX2, SSE2 or NEON if available, falls back to ScalarMagnitude
+struct SIMDMagnitude
+{
+	static void compute(const uint8_t * iq, size_t n, float * out)
+	{
+		size_t k = 0;
+
+#if defined(__AVX2__)
+		const __m256i offset = _mm256_set1_epi16(128);
+		const __m256 scale = _mm256_set1_ps(ScalarMagnitude::SCALE);
+		for (; k + 16 <= n; k += 16)
+		{
+			// 16 samples = 32 bytes, widen each half to 16 bit lanes
+			const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iq + 2*k));
+			const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iq + 2*k + 16));
+			const __m256i wlo = _mm256_sub_epi16(_mm256_cvtepu8_epi16(lo), offset);
+			const __m256i whi = _mm256_sub_epi16(_mm256_cvtepu8_epi16(hi), offset);
+
+			// madd computes I^2 + Q^2 for each adjacent pair of lanes
+			const __m256 slo = _mm256_cvtepi32_ps(_mm256_madd_epi16(wlo, wlo));
+			const __m256 shi = _mm256_cvtepi32_ps(_mm256_madd_epi16(whi, whi));
+
+			_mm256_storeu_ps(out + k, _mm256_mul_ps(_mm256_sqrt_ps(slo), scale));
+			_mm256_storeu_ps(out + k + 8, _mm256_mul_ps(_mm256_sqrt_ps(shi), scale));
+		}
+#elif defined(__SSE2__)
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i offset = _mm_set1_epi16(128);
+		const __m128 scale = _mm_set1_ps(ScalarMagnitude::SCALE);
+		for (; k + 8 <= n; k += 8)
+		{
+			// 8 samples = 16 bytes, widen to 16 bit lanes
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iq + 2*k));
+			const __m128i wlo = _mm_sub_epi16(_mm_unpacklo_epi8(v, zero), offset);
+			const __m128i whi = _mm_sub_epi16(_mm_unpackhi_epi8(v, zero), offset);
+
+			// madd computes I^2 + Q^2 for each adjacent pair of lanes
+			const __m128 slo = _mm_cvtepi32_ps(_mm_madd_epi16(wlo, wlo));
+			const __m128 shi = _mm_cvtepi32_ps(_mm_madd_epi16(whi, whi));
+
+			_mm_storeu_ps(out + k, _mm_mul_ps(_mm_sqrt_ps(slo), scale));
+			_mm_storeu_ps(out + k + 4, _mm_mul_ps(_mm_sqrt_ps(shi), scale));
+		}
+#elif defined(__ARM_NEON)
+		const int16x4_t offset = vdup_n_s16(128);
+		for (; k + 4 <= n; k += 4)
+		{
+			// 4 samples = 8 bytes, widen to 16 bit lanes
+			const int16x8_t w = vreinterpretq_s16_u16(vmovl_u8(vld1_u8(iq + 2*k)));
+			const int16x4x2_t v = vuzp_s16(vget_low_s16(w), vget_high_s16(w)); // split to I and Q
+			const int16x4_t i = vsub_s16(v.val[0], offset);
+			const int16x4_t q = vsub_s16(v.val[1], offset);
+			const int32x4_t s = vmlal_s16(vmull_s16(i, i), q, q);
+	#if defined(__aarch64__)
+			vst1q_f32(out + k, vmulq_n_f32(vsqrtq_f32(vcvtq_f32_s32(s)), ScalarMagnitude::SCALE));
+	#else
+			// no vector sqrt on 32-bit ARM, VFP sqrt is correctly rounded
+			float sums[4];
+			vst1q_f32(sums, vcvtq_f32_s32(s));
+			for (size_t j = 0; j < 4; j++)
+				out[k + j] = std::sqrt(sums[j]) * ScalarMagnitude::SCALE;
+	#endif
+		}
+#endif
+
+		ScalarMagnitude::compute(iq + 2*k, n - k, out + k);
+	}
+};
+
+// looks up the magnitude of each sample in RTLSDRBufferReader's table
+struct LUTMagnitude
+{
+	static void compute(const uint8_t * iq, size_t n, float * out)
+	{
+		const RTLSDRBufferReader::MagnitudeTable & table = RTLSDRBufferReader::getMagnitudeTable();
+
+		for (size_t k = 0; k < n; k++)
+			out[k] = table[(static_cast<size_t>(iq[2*k]) << CHAR_BIT) | iq[2*k + 1]];
+	}
+};
+
+/*
+ * The largest deviation of the raw values of n samples (2*n bytes) from the
+ * center, i.e. max(abs(b - 128)). The magnitude of each of the samples is at
+ * most sqrt(2) * maxDeviation() / 128, so this is a cheap way to find out that
+ * there is no signal.
+ */
+struct IQPeak
+{
+	static uint32_t maxDeviation(const uint8_t * iq, size_t n)
+	{
+		const size_t size = 2*n;
+		size_t k = 0;
+		uint8_t hi = 128;
+		uint8_t lo = 128;
+
+#if defined(__SSE2__)
+		if (size >= 16)
+		{
+			__m128i vhi = _mm_set1_epi8(static_cast<char>(128));
+			__m128i vlo = vhi;
+			for (; k + 16 <= size; k += 16)
+			{
+				const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(iq + k));
+				vhi = _mm_max_epu8(vhi, v);
+				vlo = _mm_min_epu8(vlo, v);
+			}
+
+			alignas(16) uint8_t his[16];
+			alignas(16) uint8_t los[16];
+			_mm_store_si128(reinterpret_cast<__m128i*>(his), vhi);
+			_mm_store_si128(reinterpret_cast<__m128i*>(los), vlo);
+			for (size_t j = 0; j < 16; j++)
+			{
+				hi = std::max(hi, his[j]);
+				lo = std::min(lo, los[j]);
+			}
+		}
+#elif defined(__ARM_NEON)
+		if (size >= 16)
+		{
+			uint8x16_t vhi = vdupq_n_u8(128);
+			uint8x16_t vlo = vhi;
+			for (; k + 16 <= size; k += 16)
+			{
+				const uint8x16_t v = vld1q_u8(iq + k);
+				vhi = vmaxq_u8(vhi, v);
+				vlo = vminq_u8(vlo, v);
+			}
+
+			uint8_t his[16];
+			uint8_t los[16];
+			vst1q_u8(his, vhi);
+			vst1q_u8(los, vlo);
+			for (size_t j = 0; j < 16; j++)
+			{
+				hi = std::max(hi, his[j]);
+				lo = std::min(lo, los[j]);
+			}
+		}
+#endif
+
+		for (; k < size; k++)
+		{
+			hi = std::max(hi, iq[k]);
+			lo = std::min(lo, iq[k]);
+		}
+
+		return std::max<uint32_t>(hi - 128, 128 - lo);
+	}
+};
+
+} // namespace rts
+
+#endif // RTS_IQ_MAGNITUDE_H
@@ -0,0 +1,299 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_IQ_MODULATOR_H
+#define RTS_IQ_MODULATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <optional>
+#include <vector>
+#include <array>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+
+#include "../../Clock.h"
+#include "../../Duration.h"
+#include "IQBlock.h"
+
+namespace rts
+{
+
+struct IQModulatorOptions
+{
+	// carrier power to noise power (in the whole band), in dB
+	double snr = 20.0;
+
+	// offset of the carrier from the center frequency (Hz), e.g. due to the
+	// tolerance of the crystals (keep it well below the decimated sample rate)
+	double frequencyOffset = 10e3;
+
+	// standard deviation of the times of the edges
+	Clock::duration jitter = Clock::duration::zero();
+
+	// amplitude of the carrier, in rtl-sdr units (the full scale is 127.5);
+	// OOKDecoder needs at least 0.71 of the full scale (about 90)
+	float amplitude = 120.0f;
+
+	// seed of the noise and the jitter, the same seed gives the same samples
+	uint32_t seed = 1;
+};
+
+/**
+ * @brief Synthetic IQ source: renders durations as an OOK modulated carrier.
+ *
+ * The output is in the raw rtl-sdr format (interleaved unsigned 8-bit I and
+ * Q, 127.5 is 0), so it can be fed to the decoder directly or written to an
+ * IQ log. The durations can come from SomfyFrameEncoder.
+ *
+ * The samples are rendered block by block. To render gigabytes quickly the
+ * kernel works on LANES samples at a time with no dependencies between the
+ * lanes, which the compiler vectorizes:
+ * * the carrier is a complex rotator per lane, each advanced by LANES
+ *   samples in a step (and renormalized every RENORMALIZE_STEPS steps, so
+ *   the output doesn't depend on the block size)
+ * * the noise is Gaussian approximated by the sum of four uniform variables
+ *   (16-bit halves of the output of two xorshift steps per lane)
+ *
+ * The edges are placed at the exact times of the durations (shifted by the
+ * jitter, if any), rounded to the sample.
+ */
+class IQModulator
+{
+public:
+	static constexpr size_t LANES = 8;
+	static constexpr size_t DEFAULT_BLOCK_SIZE = 128*1024;
+
+	/**
+	 * Render durations at sampleRate. The blocks have blockSize samples
+	 * rounded up to a multiple of LANES (the last block can be shorter).
+	 */
+	IQModulator(const std::vector<Duration> & durations, size_t sampleRate,
+			const IQModulatorOptions & options = IQModulatorOptions(), size_t blockSize = DEFAULT_BLOCK_SIZE):
+		m_durations(durations),
+		m_sampleRate(sampleRate),
+		m_jitter(options.jitter),
+		m_amplitude(options.amplitude),
+		m_noiseScale(getNoiseSigma(options) / UNIFORM_SUM_SIGMA),
+		m_blockSize((blockSize + LANES - 1) / LANES * LANES),
+		m_generator(options.seed),
+		m_sampleCount(sampleCount(getTotalDuration(durations), sampleRate)),
+		m_position(0),
+		m_index(0),
+		m_time(Clock::duration::zero()),
+		m_level(false),
+		m_levelEnd(0),
+		m_steps(0),
+		m_envelope(m_blockSize),
+		m_buffer(2*m_blockSize)
+	{
+		if (sampleRate == 0 || blockSize == 0)
+			throw std::runtime_error("sample rate and block size must be positive");
+
+		// rotators of the lanes start at phases 0, omega, 2*omega, ...; each step advances them by LANES*omega
+		const double omega = 2 * PI * options.frequencyOffset / sampleRate;
+		for (size_t l = 0; l < LANES; l++)
+		{
+			m_rotatorI[l] = static_cast<float>(std::cos(omega * l));
+			m_rotatorQ[l] = static_cast<float>(std::sin(omega * l));
+		}
+		m_stepI = static_cast<float>(std::cos(omega * LANES));
+		m_stepQ = static_cast<float>(std::sin(omega * LANES));
+
+		// xorshift must not start at 0
+		for (size_t l = 0; l < LANES; l++)
+			m_noiseState[l] = m_generator() | 1;
+
+		nextLevel();
+	}
+
+	std::optional<IQBlock> getBlock()
+	{
+		if (m_position == m_sampleCount)
+			return std::nullopt;
+
+		const size_t size = static_cast<size_t>(std::min<uint64_t>(m_blockSize, m_sampleCount - m_position));
+
+		// the amplitude of each sample
+		for (size_t i = 0; i < size; )
+		{
+			while (m_position + i >= m_levelEnd)
+				nextLevel();
+
+			const size_t end = static_cast<size_t>(std::min<uint64_t>(size, m_levelEnd - m_position));
+			std::fill(m_envelope.begin() + i, m_envelope.begin() + end, m_level ? m_amplitude : 0.0f);
+			i = end;
+		}
+
+		// the kernel renders whole steps, the rest of the last one is not used
+		std::fill(m_envelope.begin() + size, m_envelope.end(), 0.0f);
+		render((size + LANES - 1) / LANES);
+
+		m_position += size;
+		return IQBlock{m_buffer.data(), size};
+	}
+
+	// the number of samples the durations give
+	uint64_t getSampleCount() const
+	{
+		return m_sampleCount;
+	}
+
+private:
+	static constexpr double PI = 3.14159265358979323846;
+
+	static constexpr uint64_t RENORMALIZE_STEPS = 1024;
+
+	// standard deviation of the sum of four uniform variables in [-32768, 32768): 65536/sqrt(3)
+	static constexpr float UNIFORM_SUM_SIGMA = 37837.23f;
+
+	// the noise per component (I or Q) that gives the SNR
+	static float getNoiseSigma(const IQModulatorOptions & options)
+	{
+		return static_cast<float>(options.amplitude / std::sqrt(2 * std::pow(10.0, options.snr / 10)));
+	}
+
+	static Clock::duration getTotalDuration(const std::vector<Duration> & durations)
+	{
+		Clock::duration total = Clock::duration::zero();
+		for (const Duration & d: durations)
+			total += d.first;
+
+		return total;
+	}
+
+	// move to the next duration (after the last one the carrier stays off)
+	void nextLevel()
+	{
+		if (m_index == m_durations.size())
+		{
+			m_level = false;
+			m_levelEnd = m_sampleCount;
+			return;
+		}
+
+		m_level = m_durations[m_index].second;
+		m_time += m_durations[m_index].first;
+		m_index++;
+
+		Clock::duration end = m_time;
+		if (m_jitter != Clock::duration::zero() && m_index < m_durations.size())
+		{
+			std::normal_distribution<double> jitter(0.0, static_cast<double>(m_jitter.count()));
+			end += Clock::duration(static_cast<Clock::duration::rep>(jitter(m_generator)));
+		}
+
+		// the edges stay in order even with a big jitter
+		m_levelEnd = std::max(m_levelEnd, sampleCount(end, m_sampleRate));
+	}
+
+	// render steps*LANES samples from m_envelope into m_buffer
+	void render(size_t steps)
+	{
+		for (size_t k = 0; k < steps; k++)
+		{
+			// keep the rotators from drifting away from the unit circle (first order correction is enough)
+			if (m_steps++ % RENORMALIZE_STEPS == 0)
+			{
+				for (size_t l = 0; l < LANES; l++)
+				{
+					const float correction = 1.5f - 0.5f * (m_rotatorI[l] * m_rotatorI[l] + m_rotatorQ[l] * m_rotatorQ[l]);
+					m_rotatorI[l] *= correction;
+					m_rotatorQ[l] *= correction;
+				}
+			}
+
+			const float * envelope = m_envelope.data() + k*LANES;
+			std::array<float, LANES> i;
+			std::array<float, LANES> q;
+
+			for (size_t l = 0; l < LANES; l++)
+			{
+				i[l] = 127.5f + envelope[l] * m_rotatorI[l] + m_noiseScale * static_cast<float>(uniformSum(m_noiseState[l]));
+				q[l] = 127.5f + envelope[l] * m_rotatorQ[l] + m_noiseScale * static_cast<float>(uniformSum(m_noiseState[l]));
+
+				const float rotatedI = m_rotatorI[l] * m_stepI - m_rotatorQ[l] * m_stepQ;
+				const float rotatedQ = m_rotatorI[l] * m_stepQ + m_rotatorQ[l] * m_stepI;
+				m_rotatorI[l] = rotatedI;
+				m_rotatorQ[l] = rotatedQ;
+			}
+
+			// quantize (round and clip) to 8 bits
+			uint8_t * out = m_buffer.data() + 2*k*LANES;
+			for (size_t l = 0; l < LANES; l++)
+			{
+				out[2*l] = static_cast<uint8_t>(static_cast<int32_t>(std::clamp(i[l] + 0.5f, 0.0f, 255.0f)));
+				out[2*l + 1] = static_cast<uint8_t>(static_cast<int32_t>(std::clamp(q[l] + 0.5f, 0.0f, 255.0f)));
+			}
+		}
+	}
+
+	static uint32_t xorshift(uint32_t & state)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return state;
+	}
+
+	// sum of four uniform variables in [-32768, 32768)
+	static int32_t uniformSum(uint32_t & state)
+	{
+		const uint32_t a = xorshift(state);
+		const uint32_t b = xorshift(state);
+		return (static_cast<int32_t>(a << 16) >> 16) + (static_cast<int32_t>(a) >> 16) +
+			(static_cast<int32_t>(b << 16) >> 16) + (static_cast<int32_t>(b) >> 16);
+	}
+
+	const std::vector<Duration> m_durations;
+	const uint64_t m_sampleRate;
+	const Clock::duration m_jitter;
+	const float m_amplitude;
+	const float m_noiseScale;
+	const size_t m_blockSize;
+
+	std::mt19937 m_generator;
+	const uint64_t m_sampleCount;
+
+	// the next sample to render
+	uint64_t m_position;
+
+	// the current duration (m_index is the index of the next one) and where it ends
+	size_t m_index;
+	Clock::duration m_time;
+	bool m_level;
+	uint64_t m_levelEnd;
+
+	// steps rendered so far
+	uint64_t m_steps;
+
+	std::array<float, LANES> m_rotatorI;
+	std::array<float, LANES> m_rotatorQ;
+	float m_stepI;
+	float m_stepQ;
+	std::array<uint32_t, LANES> m_noiseState;
+
+	std::vector<float> m_envelope;
+	std::vector<uint8_t> m_buffer;
+};
+
+} // namespace rts
+
+#endif // RTS_IQ_MODULATOR_H
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_MEMORY_IQ_SOURCE_H
+#define RTS_MEMORY_IQ_SOURCE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+
+#include "IQBlock.h"
+
+namespace rts
+{
+
+/**
+ * @brief IQ source handing out samples that are already in memory.
+ *
+ * The samples (e.g. a memory-mapped IQ log) are split into blocks of at
+ * most blockSize samples, no data is copied.
+ */
+class MemoryIQSource
+{
+public:
+	MemoryIQSource(const IQBlock & samples, size_t blockSize):
+		m_samples(samples),
+		m_blockSize(blockSize),
+		m_offset(0)
+	{}
+
+	std::optional<IQBlock> getBlock()
+	{
+		if (m_offset == m_samples.size)
+			return std::nullopt;
+
+		const size_t size = std::min(m_blockSize, m_samples.size - m_offset);
+		const IQBlock block{m_samples.data + 2*m_offset, size};
+		m_offset += size;
+
+		return block;
+	}
+
+private:
+	const IQBlock m_samples;
+	const size_t m_blockSize;
+	size_t m_offset; // in samples
+};
+
+} // namespace rts
+
+#endif // RTS_MEMORY_IQ_SOURCE_H
@@ -21,117 +21,143 @@
 
 #include <optional>
 #include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include <cmath>
 
 #include "../../Clock.h"
 #include "../../Transition.h"
+#include "IQBlock.h"
 #include "Filter.h"
+#include "OOKDemodulator.h"
+#include "RunLengthScanner.h"
 
 namespace rts
 {
 
 // convert from IQ signal to transitions
-template<typename IQSource>
+// IQSource is expected to provide blocks of samples (see IQBlock.h),
+// Demodulator converts the samples to bits (see OOKDemodulator.h)
+// and transitions are found in the bits by RunLengthScanner
+// the filter and the minimal duration of a pulse are derived from sampleRate,
+// so the IQ source can be decimated (see CICDecimator.h)
+template<typename IQSource, typename Demodulator = OOKDemodulator<>>
 class OOKDecoder
 {
+	static_assert(Demodulator::BITS_PER_WORD == RunLengthScanner::BITS_PER_WORD, "bits must be packed in 64-bit words");
+
 public:
-	OOKDecoder(IQSource & iqSource, size_t sampleRate):
+	/**
+	 * firstSample is the index of the first sample the IQ source provides,
+	 * this is where the time stamps of the transitions start.
+	 */
+	OOKDecoder(IQSource & iqSource, size_t sampleRate, uint64_t firstSample = 0):
 		m_iqSource(iqSource),
-		m_samplePeriod(1.0f / static_cast<float>(sampleRate)),
-		m_numSamples(0),
-		/*
-		 * Butterworth low-pass filter with cut-off frequency 100 kHz (assuming sample rate 2.6 MHz)
-		 * calculated by Octave as:
-		 * Fcutoff = 1e5; % 100 kHz... this is also used by rtl_433
-		 * fs = 2.6e6; % sample rate this tool uses
-		 * [B, A] = butter(1, Fcutoff / (fs/2));
-		 */
-		m_butterworthLowPass(/*A*/ {1.0f, -0.78345f}, /*B*/ {0.10828, 0.10828})
+		m_sampleRate(sampleRate),
+		m_numSamples(firstSample),
+		m_demodulator(makeDemodulator(sampleRate)),
+		m_scanner(std::max<size_t>(1, std::lround(MIN_DURATION * sampleRate))),
+		m_blockSize(0),
+		m_readOffset(0)
 	{}
 
 	std::optional<Transition> get()
 	{
-		// minDuration = 50e-6;
-		// minSamples = minDuration*fs; % fs = 2.6e6
-		constexpr size_t minSamples = 130;
-		size_t count = 0;
-		bool startValue;
-		size_t startIndex;
-
 		// find a sequence of at least minSamples samples with the same value
-		std::optional<bool> b = getNextSample();
-		while (b)
+		while (fetchBlock())
 		{
-			if (count > 0)
-			{
-				if (*b == startValue)
-				{
-					count++;
-					if (count == minSamples)
-					{
-						// hooray!
-						m_lastValue = startValue;
-						return makeTransition(startIndex, startValue);
-					}
-					// else: continue search
-				}
-				else
-				{
-					// early transition - reset
-					count = 1;
-					startValue = *b;
-				}
-			}
-			else
-			{
-				if (*b != m_lastValue)
-				{
-					count = 1;
-					startValue = *b;
-					startIndex = m_numSamples - 1;
-				}
-			}
+			const uint64_t blockStart = m_numSamples - m_readOffset;
+			const std::optional<RunLengthScanner::Transition> t =
+				m_scanner.scan(m_bits.data(), m_blockSize, m_readOffset, blockStart);
+
+			// keep track of samples count and thus of time elapsed
+			m_numSamples = blockStart + m_readOffset;
 
-			b = getNextSample();
+			if (t)
+				return makeTransition(t->sample, t->value);
 		}
 
 		return std::nullopt;
 	}
 
+	// the time stamp of a sample, as used for the transitions
+	// (the samples are counted in 64 bits, so the time stays exact on long runs)
+	Clock::time_point getSampleTime(uint64_t sampleIndex) const
+	{
+		return Clock::time_point() + sampleTime(sampleIndex, m_sampleRate);
+	}
+
 private:
-	std::optional<bool> getNextSample()
+	/*
+	 * Butterworth low-pass filter with cut-off frequency 100 kHz (this is also
+	 * used by rtl_433). For low sample rates (decimated input) the cut-off is
+	 * lowered to a quarter of the sample rate.
+	 *
+	 * For 2.6 MHz this gives A = {1, -0.78345}, B = {0.10828, 0.10828}.
+	 */
+	static Demodulator makeDemodulator(size_t sampleRate)
 	{
-		std::optional<std::complex<float>> s = m_iqSource.getNextSample();
-		if (!s)
+		const double cutoff = std::min(FILTER_CUTOFF, sampleRate / 4.0);
+		const FirstOrderFilterCoefficients filter = designLowPassFilter(cutoff, sampleRate);
+		return Demodulator(filter.a, filter.b, THRESHOLD);
+	}
+
+	/**
+	 * Make sure there are unprocessed samples in m_bits. Returns false
+	 * if the IQ source has no more data.
+	 */
+	bool fetchBlock()
+	{
+		while (m_readOffset == m_blockSize)
 		{
-			// end of data
-			return std::nullopt;
+			// this invalidates the previous block - but it has been processed already
+			const std::optional<IQBlock> block = m_iqSource.getBlock();
+			if (!block)
+			{
+				// end of data
+				m_blockSize = 0;
+				m_readOffset = 0;
+				return false;
+			}
+
+			// demodulate the whole block at once
+			const size_t words = (block->size + Demodulator::BITS_PER_WORD - 1) / Demodulator::BITS_PER_WORD;
+			if (m_bits.size() < words)
+				m_bits.resize(words);
+			m_demodulator.process(block->data, block->size, m_bits.data());
+
+			m_blockSize = block->size;
+			m_readOffset = 0;
 		}
 
-		// keep track of samples count and thus of time elapsed
-		m_numSamples++;
+		return true;
+	}
 
-		// filter
-		const float f = m_butterworthLowPass << std::abs(*s);
+	// the range of the signal is 0 .. sqrt(2) (abs(1+i)), place
+	// the threshold in the middle
+	static constexpr float THRESHOLD = /*sqrt(2)*/ 1.4142135623730950488f / 2;
 
-		// the range of the signal is 0 .. sqrt(2) (abs(1+i)), place
-		// the threshold in the middle
-		constexpr float threshold = /*sqrt(2)*/ 1.4142135623730950488f / 2;
+	static constexpr double FILTER_CUTOFF = 100e3; // 100 kHz
 
-		return f >= threshold;
-	}
+	// a level has to last at least this long (in seconds) to be considered a transition
+	static constexpr double MIN_DURATION = 50e-6;
 
-	Transition makeTransition(size_t sampleIndex, bool newValue) const
+	Transition makeTransition(uint64_t sampleIndex, bool newValue) const
 	{
-		const Clock::time_point tp = Clock::time_point() +
-			std::chrono::duration_cast<Clock::duration>(std::chrono::duration<float>(sampleIndex * m_samplePeriod));
-		return Transition(tp, newValue);
+		return Transition(getSampleTime(sampleIndex), newValue);
 	}
 
 	IQSource & m_iqSource;
-	const float m_samplePeriod;
-	size_t m_numSamples;
-	Filter m_butterworthLowPass;
-	std::optional<bool> m_lastValue;
+	const uint64_t m_sampleRate;
+	uint64_t m_numSamples;
+	Demodulator m_demodulator;
+	RunLengthScanner m_scanner;
+
+	// demodulated bits of the current block
+	std::vector<uint64_t> m_bits;
+	size_t m_blockSize;
+	size_t m_readOffset;
 };
 
 } // namespace rts
@@ -0,0 +1,244 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_OOK_DEMODULATOR_H
+#define RTS_OOK_DEMODULATOR_H
+
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <algorithm>
+#include <cmath>
+
+#include "IQMagnitude.h"
+
+namespace rts
+{
+
+/**
+ * @brief Block kernel that converts raw rtl-sdr IQ samples to OOK bits.
+ *
+ * For each sample the magnitude of the (normalized) IQ sample is computed,
+ * it's passed through a first order IIR low-pass filter and the output of the
+ * filter is compared against a threshold. The resulting bits are packed into
+ * 64-bit words: sample i of the block is stored in bit (i % 64) of word i / 64.
+ *
+ * The magnitude is computed by the Magnitude front end (see IQMagnitude.h),
+ * by default using SIMD instructions when available. process() and
+ * processScalar() produce bit-identical results: all the front ends do, and
+ * the filter recurrence is shared and it's identical to what Filter does.
+ *
+ * Quiet parts of the signal are skipped: the samples are processed in
+ * segments of GATE_SIZE and if the raw values of a segment (IQPeak) are so
+ * small that the output of the filter can't reach the threshold, the
+ * magnitudes aren't computed at all and the bits are all 0 (this is exact,
+ * the bound holds for any state of the filter). The filter is then run just
+ * over the last few samples of the segment, starting from an estimated state.
+ * The influence of the initial state decays exponentially, so the state at the
+ * end of the segment is equivalent to the one computed sample by sample within
+ * rounding, but not necessarily bit-identical: the two can stay an ULP or so
+ * apart, and if the output of the filter is that close to the threshold later
+ * on, the bit can differ.
+ */
+template<typename Magnitude = SIMDMagnitude>
+class OOKDemodulator
+{
+public:
+	/**
+	 * Create the demodulator for a filter given by a = {a_0, a_1}, b = {b_0, b_1}
+	 * (see Filter for the meaning of the coefficients).
+	 */
+	OOKDemodulator(const std::array<float, 2> & a, const std::array<float, 2> & b, float threshold):
+		m_a(a),
+		m_b(b),
+		m_threshold(threshold),
+		m_lastInput(0.0f),
+		m_lastOutput(0.0f),
+		m_gain((std::abs(b[0]) + std::abs(b[1])) / std::abs(a[0])),
+		m_pole(std::abs(a[1] / a[0])),
+		m_settlingSamples(getSettlingSamples(m_pole))
+	{}
+
+	/**
+	 * Demodulate count samples from iq (2*count bytes) and store the bits into
+	 * bits which must have room for (count + 63) / 64 words.
+	 */
+	void process(const uint8_t * iq, size_t count, uint64_t * bits)
+	{
+		processImpl<Magnitude>(iq, count, bits);
+	}
+
+	/**
+	 * Same as process(), but uses ScalarMagnitude. Intended as a reference.
+	 */
+	void processScalar(const uint8_t * iq, size_t count, uint64_t * bits)
+	{
+		processImpl<ScalarMagnitude>(iq, count, bits);
+	}
+
+	static constexpr size_t BITS_PER_WORD = 64;
+
+	// samples checked at once for being quiet, a multiple of BITS_PER_WORD
+	static constexpr size_t GATE_SIZE = 4096;
+
+private:
+	template<typename MagnitudeFrontEnd>
+	void processImpl(const uint8_t * iq, size_t count, uint64_t * bits)
+	{
+		while (count > 0)
+		{
+			const size_t n = count < GATE_SIZE ? count : GATE_SIZE;
+			const size_t words = (n + BITS_PER_WORD - 1) / BITS_PER_WORD;
+
+			if (isQuiet(iq, n))
+			{
+				settle<MagnitudeFrontEnd>(iq, n);
+				std::fill_n(bits, words, 0);
+			}
+			else
+				processSegment<MagnitudeFrontEnd>(iq, n, bits);
+
+			bits += words;
+			iq += 2*n;
+			count -= n;
+		}
+	}
+
+	template<typename MagnitudeFrontEnd>
+	void processSegment(const uint8_t * iq, size_t count, uint64_t * bits)
+	{
+		float magnitudes[BITS_PER_WORD];
+
+		while (count > 0)
+		{
+			const size_t n = count < BITS_PER_WORD ? count : BITS_PER_WORD;
+
+			MagnitudeFrontEnd::compute(iq, n, magnitudes);
+
+			*bits++ = filterAndThreshold(magnitudes, n);
+
+			iq += 2*n;
+			count -= n;
+		}
+	}
+
+	/*
+	 * Can the output of the filter reach the threshold within the count
+	 * samples? With |x_k| <= X and |y_{k-1}| <= Y, |y_k| <= gain*X + pole*Y,
+	 * so |y_k| <= max(|y_0|, gain*X / (1 - pole)).
+	 */
+	bool isQuiet(const uint8_t * iq, size_t count) const
+	{
+		if (m_settlingSamples == 0 || count < 2*m_settlingSamples)
+			return false;
+
+		const float peak = IQPeak::maxDeviation(iq, count) * MAX_MAGNITUDE_PER_DEVIATION;
+		const float input = std::max(peak, std::abs(m_lastInput));
+		const float bound = std::max(std::abs(m_lastOutput), m_gain * input / (1.0f - m_pole));
+
+		// leave some room for the rounding errors
+		return bound * (1.0f + BOUND_MARGIN) < m_threshold;
+	}
+
+	// bring the filter into the state after the count samples, their output is not needed
+	template<typename MagnitudeFrontEnd>
+	void settle(const uint8_t * iq, size_t count)
+	{
+		float magnitudes[BITS_PER_WORD];
+
+		// start from the steady state for the first input
+		const uint8_t * tail = iq + 2*(count - m_settlingSamples);
+		MagnitudeFrontEnd::compute(tail, 1, magnitudes);
+		m_lastInput = magnitudes[0];
+		m_lastOutput = magnitudes[0];
+
+		for (size_t k = 1; k < m_settlingSamples; )
+		{
+			const size_t n = std::min(m_settlingSamples - k, BITS_PER_WORD);
+			MagnitudeFrontEnd::compute(tail + 2*k, n, magnitudes);
+			filterAndThreshold(magnitudes, n);
+			k += n;
+		}
+	}
+
+	/*
+	 * Number of samples after which the initial state of the filter has no
+	 * influence (pole^n < SETTLING_ERROR), 0 if it's too many (or the filter
+	 * is not stable) and skipping quiet segments is not worth it.
+	 */
+	static size_t getSettlingSamples(float pole)
+	{
+		if (pole == 0.0f)
+			return 2;
+		if (pole >= 1.0f)
+			return 0;
+
+		const double n = std::ceil(std::log(SETTLING_ERROR) / std::log(pole)) + 1;
+		return n <= GATE_SIZE / 8 ? static_cast<size_t>(n) : 0;
+	}
+
+	uint64_t filterAndThreshold(const float * x, size_t n)
+	{
+		uint64_t word = 0;
+		float x1 = m_lastInput;
+		float y1 = m_lastOutput;
+
+		for (size_t i = 0; i < n; i++)
+		{
+			// same order of operations as in Filter::operator<<
+			float y = 0.0f;
+			y += x1 * m_b[1];
+			y += x[i] * m_b[0];
+			y -= y1 * m_a[1];
+			y /= m_a[0];
+
+			word |= static_cast<uint64_t>(y >= m_threshold) << i;
+
+			x1 = x[i];
+			y1 = y;
+		}
+
+		m_lastInput = x1;
+		m_lastOutput = y1;
+		return word;
+	}
+
+	// sqrt(2) / 128: the largest magnitude of a sample for the deviation of 1
+	static constexpr float MAX_MAGNITUDE_PER_DEVIATION = 1.4142135623730950488f / 128;
+	static constexpr float BOUND_MARGIN = 1e-4f;
+
+	// far below the resolution of float (the rounding errors remain, though)
+	static constexpr double SETTLING_ERROR = 1e-12;
+
+	const std::array<float, 2> m_a;
+	const std::array<float, 2> m_b;
+	const float m_threshold;
+
+	// filter state: x_{k-1} and y_{k-1}
+	float m_lastInput;
+	float m_lastOutput;
+
+	// used to skip quiet segments, see isQuiet()
+	const float m_gain;
+	const float m_pole;
+	const size_t m_settlingSamples;
+};
+
+} // namespace rts
+
+#endif // RTS_OOK_DEMODULATOR_H
@@ -0,0 +1,239 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_PARALLEL_IQ_DECODER_H
+#define RTS_PARALLEL_IQ_DECODER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+#include "../../Clock.h"
+#include "../../DurationTracker.h"
+#include "../../SomfyDecoder.h"
+#include "../../SomfyFrameEvent.h"
+#include "CICDecimator.h"
+#include "IQBlock.h"
+#include "MemoryIQSource.h"
+#include "OOKDecoder.h"
+#include "OOKDemodulator.h"
+
+namespace rts
+{
+
+/**
+ * @brief Decode IQ samples that are in memory (e.g. a mapped IQ log) using
+ * several threads.
+ *
+ * The samples are split into chunks which are decoded independently, each by
+ * its own CICDecimator -> OOKDecoder -> DurationTracker -> SomfyDecoder chain.
+ * Each chunk is extended by overlap on both sides: the leading overlap lets
+ * the filters, the transition search and the decoder's state machines
+ * settle, so that by the start of its own part the chunk is in the same
+ * state as a single decoder reading all the samples. It has to be longer
+ * than a frame (~110 ms) plus the filter warm-up. The trailing overlap
+ * completes the frames that start in the chunk. The state comes from the
+ * recent samples only (DurationTracker goes on after glitches, see
+ * DurationTracker.h), so this holds for noisy signals too - but it's a
+ * matter of the signal, not a guarantee: a level that doesn't change for
+ * the whole overlap could still leave a chunk out of step.
+ *
+ * Each event of a SomfyDecoder (see SomfyFrameEvent.h) is stamped with the
+ * time of the transition that caused it. A chunk keeps only the events stamped
+ * with a time inside its own part, so the events in the overlaps (found by
+ * both neighbouring chunks) are not duplicated. When all chunks are done, the
+ * events are passed to the listener in the order of the chunks, i.e. in the
+ * order of time. So the listener gets the same calls as if it was used by a
+ * single SomfyDecoder.
+ */
+template<typename Demodulator = OOKDemodulator<>>
+class ParallelIQDecoder
+{
+public:
+	/**
+	 * iq are the samples at sampleRate, decimation and tolerance are the same
+	 * as for CICDecimator and SomfyDecoder. The decimation has to divide the
+	 * sample rate, so that the time stamps stay exact. threadCount == 0 means
+	 * one thread per CPU.
+	 */
+	ParallelIQDecoder(const IQBlock & iq, size_t sampleRate, size_t decimation, double tolerance,
+		unsigned threadCount = 0, Clock::duration overlap = DEFAULT_OVERLAP):
+		m_iq(iq),
+		m_sampleRate(sampleRate),
+		m_decimation(decimation),
+		m_tolerance(tolerance),
+		m_threadCount(threadCount != 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency())),
+		m_overlap(toSamples(overlap, getDecimatedRate(sampleRate, decimation)))
+	{}
+
+	template<typename Listener>
+	void run(Listener & listener)
+	{
+		const std::vector<size_t> boundaries = splitIntoChunks();
+		std::vector<std::vector<SomfyFrameEvent>> events(boundaries.size() - 1);
+
+		std::atomic<size_t> nextChunk(0);
+		std::vector<std::exception_ptr> errors(m_threadCount);
+		std::vector<std::thread> threads;
+		for (unsigned t = 0; t < m_threadCount; t++)
+		{
+			threads.emplace_back([&, t]() {
+				try
+				{
+					for (size_t i = nextChunk++; i < events.size(); i = nextChunk++)
+						events[i] = decodeChunk(boundaries, i);
+				}
+				catch (...)
+				{
+					errors[t] = std::current_exception();
+				}
+			});
+		}
+
+		for (std::thread & thread: threads)
+			thread.join();
+
+		for (const std::exception_ptr & error: errors)
+			if (error)
+				std::rethrow_exception(error);
+
+		for (const std::vector<SomfyFrameEvent> & chunkEvents: events)
+			for (const SomfyFrameEvent & event: chunkEvents)
+				listener.onEvent(event);
+	}
+
+	// must be longer than the longest frame (~110 ms) plus the filter warm-up
+	static constexpr Clock::duration DEFAULT_OVERLAP = std::chrono::milliseconds(250);
+
+private:
+	static size_t getDecimatedRate(size_t sampleRate, size_t decimation)
+	{
+		if (decimation == 0)
+			throw std::runtime_error("decimation must be positive");
+
+		if (sampleRate % decimation != 0)
+			throw std::runtime_error("decimation " + std::to_string(decimation) +
+				" doesn't divide the sample rate " + std::to_string(sampleRate));
+
+		return sampleRate / decimation;
+	}
+
+	// the IQ samples are provided in blocks of this many samples
+	static constexpr size_t BLOCK_SIZE = 512*1024;
+
+	// there are this many chunks per thread, so that the threads finish at about the same time
+	static constexpr size_t CHUNKS_PER_THREAD = 4;
+
+	// SomfyDecoder listener that keeps the events that happen in [from, to)
+	class EventRecorder
+	{
+	public:
+		EventRecorder(std::optional<Clock::time_point> from, std::optional<Clock::time_point> to,
+				std::vector<SomfyFrameEvent> & events):
+			m_from(from),
+			m_to(to),
+			m_events(&events)
+		{}
+
+		void onEvent(const SomfyFrameEvent & event)
+		{
+			if ((!m_from || event.time >= *m_from) && (!m_to || event.time < *m_to))
+				m_events->push_back(event);
+		}
+
+	private:
+		const std::optional<Clock::time_point> m_from;
+		const std::optional<Clock::time_point> m_to;
+		std::vector<SomfyFrameEvent> * m_events;
+	};
+
+	static size_t toSamples(Clock::duration duration, size_t sampleRate)
+	{
+		return sampleCount(duration, sampleRate) + 1;
+	}
+
+	/*
+	 * Split the (decimated) samples into chunks. Chunk i is [boundaries[i],
+	 * boundaries[i + 1]). The chunks are at least a few overlaps long, so that
+	 * most of the work isn't done twice.
+	 */
+	std::vector<size_t> splitIntoChunks() const
+	{
+		const size_t sampleCount = m_iq.size / m_decimation;
+		const size_t minChunkSize = 8 * m_overlap;
+		const size_t chunkCount = std::max<size_t>(1, std::min(m_threadCount * CHUNKS_PER_THREAD, sampleCount / minChunkSize));
+
+		std::vector<size_t> boundaries;
+		for (size_t i = 0; i <= chunkCount; i++)
+			boundaries.push_back(sampleCount / chunkCount * i + std::min(i, sampleCount % chunkCount));
+
+		return boundaries;
+	}
+
+	std::vector<SomfyFrameEvent> decodeChunk(const std::vector<size_t> & boundaries, size_t chunk) const
+	{
+		const size_t first = chunk == 0 ? 0 : boundaries[chunk] - std::min(m_overlap, boundaries[chunk]);
+		const size_t last = chunk + 2 == boundaries.size() ? boundaries.back() : std::min(boundaries[chunk + 1] + m_overlap, boundaries.back());
+
+		// the chunk starts at a multiple of decimation, so the decimated samples are the same as without chunks
+		const IQBlock chunkIQ{m_iq.data + 2*first*m_decimation,
+			chunk + 2 == boundaries.size() ? m_iq.size - first*m_decimation : (last - first)*m_decimation};
+
+		typedef CICDecimator<MemoryIQSource> Decimator;
+		typedef OOKDecoder<Decimator, Demodulator> Decoder;
+		typedef DurationTracker<Decoder> Tracker;
+
+		MemoryIQSource source(chunkIQ, BLOCK_SIZE);
+		Decimator decimator(source, m_decimation);
+		Decoder ookDecoder(decimator, m_sampleRate / m_decimation, first);
+		Tracker durationTracker(ookDecoder);
+
+		// the first chunk owns everything before its end, the last one everything after its start
+		const std::optional<Clock::time_point> from = chunk == 0 ?
+			std::nullopt : std::optional<Clock::time_point>(ookDecoder.getSampleTime(boundaries[chunk]));
+		const std::optional<Clock::time_point> to = chunk + 2 == boundaries.size() ?
+			std::nullopt : std::optional<Clock::time_point>(ookDecoder.getSampleTime(boundaries[chunk + 1]));
+
+		std::vector<SomfyFrameEvent> events;
+		SomfyDecoder<Tracker, EventRecorder> decoder(durationTracker, m_tolerance, EventRecorder(from, to, events));
+		decoder.run();
+
+		return events;
+	}
+
+	const IQBlock m_iq;
+	const size_t m_sampleRate;
+	const size_t m_decimation;
+	const double m_tolerance;
+	const unsigned m_threadCount;
+
+	// in decimated samples
+	const size_t m_overlap;
+};
+
+} // namespace rts
+
+#endif // RTS_PARALLEL_IQ_DECODER_H
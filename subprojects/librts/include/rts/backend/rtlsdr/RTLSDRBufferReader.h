@@ -20,6 +20,12 @@
 #define RTS_RTLSDR_BUFFER_READER_H
 
 #include <complex>
+#include <cstdint>
+#include <climits>
+#include <array>
+#include <stdexcept>
+
+#include "IQBlock.h"
 
 namespace rts
 {
@@ -37,6 +43,12 @@ public:
 		reset(nullptr, 0);
 	}
 
+	void reset(const IQBlock & block)
+	{
+		m_buffer = block.data;
+		m_size = block.size;
+	}
+
 	void reset(const uint8_t * buffer, size_t size)
 	{
 		m_buffer = buffer;
@@ -54,13 +66,53 @@ public:
 
 	std::complex<float> at(size_t index) const
 	{
-		if (index > m_size)
+		if (index >= m_size)
 			throw std::runtime_error("index out of bounds");
 
+		return (*this)[index];
+	}
+
+	// like at() but without the bounds check, for use in the demodulation loop
+	std::complex<float> operator[](size_t index) const
+	{
 		return std::complex<float>(normalize(m_buffer[2*index]), normalize(m_buffer[2*index + 1]));
 	}
 
+	/**
+	 * Get the magnitude of the sample at index. This is the same as
+	 * std::abs(at(index)) except for the bounds check, but it uses a lookup
+	 * table instead of the conversion to float and sqrt.
+	 */
+	float magnitude(size_t index) const
+	{
+		return magnitude(m_buffer[2*index], m_buffer[2*index + 1]);
+	}
+
+	static float magnitude(uint8_t i, uint8_t q)
+	{
+		return getMagnitudeTable()[(static_cast<size_t>(i) << CHAR_BIT) | q];
+	}
+
+	// the magnitude of each possible raw sample, indexed by (i << 8) | q
+	typedef std::array<float, 1 << (2*CHAR_BIT)> MagnitudeTable;
+
+	static const MagnitudeTable & getMagnitudeTable()
+	{
+		static const MagnitudeTable table = makeMagnitudeTable();
+		return table;
+	}
+
 private:
+	static MagnitudeTable makeMagnitudeTable()
+	{
+		MagnitudeTable table;
+		for (size_t i = 0; i <= UINT8_MAX; i++)
+			for (size_t q = 0; q <= UINT8_MAX; q++)
+				table[(i << CHAR_BIT) | q] = std::abs(std::complex<float>(normalize(i), normalize(q)));
+
+		return table;
+	}
+
 	static float normalize(uint8_t sample)
 	{
 		// Octave's uint8=>double conversion in audioread() seems to
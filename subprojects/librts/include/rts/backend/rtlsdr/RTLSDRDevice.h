@@ -22,6 +22,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <vector>
+#include <functional>
 
 #include <rtl-sdr.h>
 
@@ -45,7 +46,26 @@ public:
 
 	size_t readSync(uint8_t * buffer, size_t size);
 
+	typedef std::function<void(uint8_t * data, size_t size)> AsyncCallback;
+
+	/**
+	 * Stream samples until cancelAsync() is called. The device keeps
+	 * transferCount USB transfers of transferLength bytes queued. callback
+	 * is called (in the calling thread) for each completed transfer and the
+	 * buffer is resubmitted when the callback returns.
+	 *
+	 * transferLength must be a multiple of 512. Zero selects the librtlsdr
+	 * default for both parameters.
+	 */
+	void readAsync(const AsyncCallback & callback, uint32_t transferCount, uint32_t transferLength);
+
+	// make readAsync() return, can be called from any thread
+	void cancelAsync();
+
 private:
+	static void asyncCallback(unsigned char * buffer, uint32_t length, void * context);
+
+
 	rtlsdr_dev_t * m_device;
 	bool m_reading;
 };
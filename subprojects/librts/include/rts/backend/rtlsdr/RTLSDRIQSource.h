@@ -19,70 +19,16 @@
 #ifndef RTS_RTLSDR_IQ_SOURCE
 #define RTS_RTLSDR_IQ_SOURCE
 
-#include <cstdint>
-#include <thread>
-#include <condition_variable>
-#include <optional>
-#include <complex>
-#include <vector>
-#include <memory>
-#include <string>
-
-#include <fstream>
-
-#include <boost/circular_buffer.hpp>
-
 #include "RTLSDRDevice.h"
-#include "RTLSDRBufferReader.h"
+#include "BasicRTLSDRIQSource.h"
 
 namespace rts
 {
 
-class RTLSDRIQSource
-{
-public:
-	RTLSDRIQSource(RTLSDRDevice & rtlSdrDevice, size_t bufferSize, size_t bufferCount,
-		const std::string & logName);
-
-	void start();
-	void stop();
-
-	std::optional<std::complex<float>> getNextSample();
-
-private:
-	typedef std::vector<uint8_t> TBuffer;
-
-	void recordingLoop();
-	void readBuffer(TBuffer & buffer);
-
-	RTLSDRDevice & m_rtlSDRDevice;
-
-	/***
-	 * Mutex protecting m_recordedBuffers, m_freeBuffers and m_running.
-	 * Locking order must be: 1) m_mutex, 2) m_recordingMutex.
-	 */
-	std::mutex m_recordingMutex;
-	std::condition_variable m_freeBuffersCondVar;
-	std::vector<std::unique_ptr<TBuffer>> m_freeBuffers;
-	std::condition_variable m_recordedBuffersCondVar;
-	boost::circular_buffer<std::unique_ptr<TBuffer>> m_recordedBuffers;
-	bool m_running;
-
-	/***
-	 * Mutex protecting all members except for m_recordedBuffers, m_freeBuffers and m_running.
-	 * Locking order must be: 1) m_mutex, 2) m_recordingMutex.
-	 */
-	std::mutex m_mutex;
-
-	std::unique_ptr<TBuffer> m_currentBuffer;
-
-	RTLSDRBufferReader m_bufferReader;
-	size_t m_readOffset;
-
-	std::thread m_thread;
+typedef BasicRTLSDRIQSource<RTLSDRDevice> RTLSDRIQSource;
 
-	std::ofstream m_log;
-};
+// instantiated in RTLSDRIQSource.cpp
+extern template class BasicRTLSDRIQSource<RTLSDRDevice>;
 
 } // namespace rts
 
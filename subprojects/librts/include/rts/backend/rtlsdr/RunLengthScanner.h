@@ -0,0 +1,170 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef RTS_RUN_LENGTH_SCANNER_H
+#define RTS_RUN_LENGTH_SCANNER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <algorithm>
+
+namespace rts
+{
+
+/**
+ * @brief Finds transitions in demodulated OOK bits.
+ *
+ * The bits are packed as produced by OOKDemodulator: sample i of a block is
+ * bit (i % 64) of word i / 64. A transition is a run of at least minSamples
+ * equal bits that starts with a bit different from the value of the last
+ * transition. It's reported at the sample that started it, even if the level
+ * changed back and forth in between (a glitch shorter than minSamples).
+ *
+ * Instead of looking at the bits one by one, whole words are compared: the
+ * next bit of a given value is found by count-trailing-zeros on the word
+ * (XORed with the value), so a steady level costs a single step per 64
+ * samples.
+ *
+ * The search continues across blocks: scan() the blocks one after another.
+ */
+class RunLengthScanner
+{
+public:
+	struct Transition
+	{
+		uint64_t sample; // index of the first sample of the run
+		bool value;
+	};
+
+	static constexpr size_t BITS_PER_WORD = 64;
+
+	RunLengthScanner(size_t minSamples):
+		m_minSamples(minSamples),
+		m_count(0),
+		m_runValue(false),
+		m_runStart(0),
+		m_haveLastValue(false),
+		m_lastValue(false)
+	{}
+
+	/**
+	 * Scan bits [offset, size) of a block whose bit 0 is sample firstSample.
+	 *
+	 * If a transition is found, offset is moved just past the minSamples-th
+	 * sample of the run and the transition is returned. Otherwise offset is
+	 * moved to size and std::nullopt is returned.
+	 */
+	std::optional<Transition> scan(const uint64_t * bits, size_t size, size_t & offset, uint64_t firstSample)
+	{
+		while (offset < size)
+		{
+			if (m_count == 0)
+			{
+				// look for the start of a run of a different value
+				const size_t start = m_haveLastValue ? find(bits, size, offset, !m_lastValue) : offset;
+				if (start == size)
+				{
+					offset = size;
+					return std::nullopt;
+				}
+
+				m_runValue = getBit(bits, start);
+				m_runStart = firstSample + start;
+				m_count = 1;
+				offset = start + 1;
+			}
+			else
+			{
+				// the current run goes on until a bit of the other value
+				const size_t end = offset + std::min<uint64_t>(size - offset, m_minSamples - m_count);
+				const size_t change = find(bits, end, offset, !m_runValue);
+				m_count += change - offset;
+				offset = change;
+
+				if (change == end)
+				{
+					if (m_count < m_minSamples)
+						return std::nullopt; // end of the block, continue in the next one
+				}
+				else
+				{
+					// early transition - a new run starts (but the transition started before)
+					m_runValue = !m_runValue;
+					m_count = 1;
+					offset++;
+				}
+			}
+
+			if (m_count >= m_minSamples)
+			{
+				m_haveLastValue = true;
+				m_lastValue = m_runValue;
+				m_count = 0;
+				return Transition{m_runStart, m_runValue};
+			}
+		}
+
+		return std::nullopt;
+	}
+
+private:
+	static bool getBit(const uint64_t * bits, size_t index)
+	{
+		return (bits[index / BITS_PER_WORD] >> (index % BITS_PER_WORD)) & 1;
+	}
+
+	// index of the first bit in [from, to) that equals value, to if there is none
+	static size_t find(const uint64_t * bits, size_t to, size_t from, bool value)
+	{
+		if (from >= to)
+			return to;
+
+		const uint64_t invert = value ? 0 : ~uint64_t(0);
+		size_t word = from / BITS_PER_WORD;
+
+		// ignore the bits before from in the first word
+		uint64_t w = (bits[word] ^ invert) & (~uint64_t(0) << (from % BITS_PER_WORD));
+		const size_t lastWord = (to - 1) / BITS_PER_WORD;
+		while (w == 0)
+		{
+			if (word == lastWord)
+				return to;
+
+			w = bits[++word] ^ invert;
+		}
+
+		const size_t index = word * BITS_PER_WORD + __builtin_ctzll(w);
+		return index < to ? index : to;
+	}
+
+	const uint64_t m_minSamples;
+
+	// the run being tracked (if m_count > 0)
+	uint64_t m_count;
+	bool m_runValue;
+	uint64_t m_runStart;
+
+	// the value of the last reported transition (if m_haveLastValue)
+	bool m_haveLastValue;
+	bool m_lastValue;
+};
+
+} // namespace rts
+
+#endif // RTS_RUN_LENGTH_SCANNER_H
@@ -0,0 +1,183 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "LogFileWriter.h"
+
+#include <system_error>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace rts
+{
+
+namespace
+{
+	// O_DIRECT needs the buffer aligned to the logical block size of the device
+	constexpr size_t CHUNK_ALIGNMENT = 4096;
+
+	int openLogFile(const std::string & fileName, bool directIO)
+	{
+		const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC | (directIO ? O_DIRECT : 0);
+		return open(fileName.c_str(), flags, 0644);
+	}
+}
+
+LogFileWriter::LogFileWriter(const std::string & fileName, const LogFileOptions & options):
+	m_fd(-1),
+	m_directIO(options.directIO),
+	m_chunk(nullptr),
+	m_chunkFill(0),
+	m_fileOffset(0)
+{
+	m_fd = openLogFile(fileName, m_directIO);
+	if (m_fd < 0 && m_directIO && errno == EINVAL)
+	{
+		// the file system doesn't support O_DIRECT (e.g. tmpfs)
+		m_directIO = false;
+		m_fd = openLogFile(fileName, m_directIO);
+	}
+
+	if (m_fd < 0)
+		throw std::system_error(errno, std::generic_category(), std::string("Can't open log file ") + fileName);
+
+	if (options.preallocate > 0)
+	{
+		// keep the size so that the file doesn't appear to contain zeros if not closed properly
+		const int r = fallocate(m_fd, FALLOC_FL_KEEP_SIZE, 0, options.preallocate);
+		if (r != 0 && errno != EOPNOTSUPP)
+		{
+			const int e = errno;
+			::close(m_fd);
+			throw std::system_error(e, std::generic_category(), std::string("Can't preallocate log file ") + fileName);
+		}
+		// else: not supported by the file system, just go on without it
+	}
+	else
+	{
+		posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+
+	void * chunk;
+	const int r = posix_memalign(&chunk, CHUNK_ALIGNMENT, CHUNK_SIZE);
+	if (r != 0)
+	{
+		::close(m_fd);
+		throw std::system_error(r, std::generic_category(), "Can't allocate log buffer");
+	}
+	m_chunk = static_cast<uint8_t*>(chunk);
+}
+
+LogFileWriter::~LogFileWriter()
+{
+	try
+	{
+		close();
+	}
+	catch (const std::system_error &)
+	{
+		// nothing can be done about it here
+	}
+
+	free(m_chunk);
+}
+
+void LogFileWriter::write(const uint8_t * data, size_t size)
+{
+	if (m_fd < 0)
+		throw std::system_error(EBADF, std::generic_category(), "log file already closed");
+
+	while (size > 0)
+	{
+		const size_t count = std::min(size, CHUNK_SIZE - m_chunkFill);
+		std::memcpy(m_chunk + m_chunkFill, data, count);
+		m_chunkFill += count;
+		data += count;
+		size -= count;
+
+		if (m_chunkFill == CHUNK_SIZE)
+			writeChunk(CHUNK_SIZE);
+	}
+}
+
+void LogFileWriter::close()
+{
+	if (m_fd < 0)
+		return;
+
+	try
+	{
+		flush();
+
+		// release the preallocated space that hasn't been used
+		if (ftruncate(m_fd, m_fileOffset) != 0)
+			throw std::system_error(errno, std::generic_category(), "Can't truncate log file");
+	}
+	catch (...)
+	{
+		::close(m_fd);
+		m_fd = -1;
+		throw;
+	}
+
+	::close(m_fd);
+	m_fd = -1;
+}
+
+void LogFileWriter::flush()
+{
+	if (m_chunkFill == 0)
+		return;
+
+	// the last chunk is partial, O_DIRECT can't write that
+	if (m_directIO)
+	{
+		const int flags = fcntl(m_fd, F_GETFL);
+		if (flags < 0 || fcntl(m_fd, F_SETFL, flags & ~O_DIRECT) != 0)
+			throw std::system_error(errno, std::generic_category(), "Can't write log file");
+		m_directIO = false;
+	}
+
+	writeChunk(m_chunkFill);
+}
+
+void LogFileWriter::writeChunk(size_t size)
+{
+	size_t written = 0;
+	while (written < size)
+	{
+		const ssize_t r = pwrite(m_fd, m_chunk + written, size - written, m_fileOffset + written);
+		if (r < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			throw std::system_error(errno, std::generic_category(), "Can't write log file");
+		}
+
+		written += r;
+	}
+
+	m_fileOffset += size;
+	m_chunkFill = 0;
+}
+
+} // namespace rts
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "SomfyFrameEncoder.h"
+#include "SomfyFrameHeader.h"
+#include "ManchesterEncoder.h"
+
+#include <vector>
+#include <cstdint>
+#include <chrono>
+
+namespace rts
+{
+
+using namespace std::literals;
+
+const Duration SomfyFrameEncoder::INTER_FRAME_GAP(27555us, false);
+
+void SomfyFrameEncoder::appendFrame(DurationBuffer & buffer, SomfyFrameType frameType, const SomfyFrame & frame, size_t bitCount)
+{
+	const SomfyFrameHeader & header = frameType == SomfyFrameType::normal ? SOMFY_HEADER_NORMAL : SOMFY_HEADER_REPEAT;
+	for (size_t i = 0; i < header.count; i++)
+		buffer << header.durations[i];
+
+	ManchesterEncoder encoder;
+	const SomfyFrame::Bytes bytes = frame.getByteArray();
+	for (size_t i = 0; i < bitCount; i++)
+		encoder << (((bytes[i / CHAR_BIT] << (i % CHAR_BIT)) & 0x80) != 0); // MSB first
+
+	for (const Duration & d: encoder.getDurations())
+		buffer << d;
+}
+
+void SomfyFrameEncoder::appendTransmission(DurationBuffer & buffer, const SomfyFrame & frame, size_t repeatFrameCount)
+{
+	appendFrame(buffer, SomfyFrameType::normal, frame);
+	buffer << INTER_FRAME_GAP;
+
+	for (size_t i = 0; i < repeatFrameCount; i++)
+	{
+		appendFrame(buffer, SomfyFrameType::repeat, frame);
+		buffer << INTER_FRAME_GAP;
+	}
+}
+
+} // namespace rts
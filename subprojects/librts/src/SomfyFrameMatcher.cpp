@@ -21,109 +21,190 @@
 
 #include <cmath>
 #include <chrono>
-
-#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
 
 namespace rts
 {
 
+namespace
+{
+	/*
+	 * The reference comparisons, done in (double) seconds. These are only
+	 * used to build the windows, the transitions are then classified by
+	 * integer compares that give exactly the same results.
+	 */
+	bool matchDuration(Clock::duration actual, Clock::duration expected, double tolerance)
+	{
+		const double a = std::chrono::duration<double>(actual).count();
+		const double e = std::chrono::duration<double>(expected).count();
+
+		return fabs(a - e) < tolerance * e;
+	}
+
+	bool matchDurationAtLeast(Clock::duration actual, Clock::duration expected, double tolerance)
+	{
+		const double a = std::chrono::duration<double>(actual).count();
+		const double e = std::chrono::duration<double>(expected).count();
+
+		return a - e > - tolerance * e;
+	}
+}
+
 SomfyFrameMatcher::SomfyFrameMatcher(double tolerance):
-	m_tolerance(tolerance),
-	m_matcherNormal(SOMFY_HEADER_NORMAL.durations, SOMFY_HEADER_NORMAL.count),
-	m_matcherRepeat(SOMFY_HEADER_REPEAT.durations, SOMFY_HEADER_REPEAT.count)
-{}
+	m_firstSteps(0),
+	m_symbolCount(0),
+	m_state(0)
+{
+	if (!std::isfinite(tolerance) || tolerance < 0)
+		throw std::runtime_error("SomfyFrameMatcher: tolerance must be a non-negative number");
+
+	// the order matters: if more headers are matched at once, the first one wins
+	addHeader(SOMFY_HEADER_NORMAL.durations, SOMFY_HEADER_NORMAL.count, SomfyFrameType::normal, tolerance);
+	addHeader(SOMFY_HEADER_REPEAT.durations, SOMFY_HEADER_REPEAT.count, SomfyFrameType::repeat, tolerance);
+
+	buildAutomaton();
+}
 
 void SomfyFrameMatcher::reset()
 {
-	m_matcherNormal.reset();
-	m_matcherRepeat.reset();
+	// state 0 is the one with no partial matches
+	m_state = 0;
 }
 
 std::optional<SomfyFrameMatcher::FrameMatch> SomfyFrameMatcher::newTransition(const Duration & duration)
 {
-	std::optional<FrameMatch> frameMatch;
-	std::optional<Clock::duration> remainingDuration = m_matcherNormal.newTransition(duration, m_tolerance);
-	if (remainingDuration)
-	{
-		// normal frame was matched
-		frameMatch = FrameMatch(SomfyFrameType::normal, *remainingDuration, duration.second);
-	}
-	else
-	{
-		// try repeat frame
-		remainingDuration = m_matcherRepeat.newTransition(duration, m_tolerance);
-		if (remainingDuration)
-		{
-			// repeat frame was matched
-			frameMatch = FrameMatch(SomfyFrameType::repeat, *remainingDuration, duration.second);
-		}
-	}
+	m_state = m_table[m_state * m_symbolCount + getSymbol(duration)];
 
-	if (frameMatch)
-	{
-		m_matcherNormal.reset();
-		m_matcherRepeat.reset();
-	}
+	const size_t header = m_accepting[m_state];
+	if (header == NO_MATCH)
+		return std::nullopt;
+
+	const SomfyFrameType type = m_headers[header].first;
+	const Window & last = m_steps[m_headers[header].second];
+	const Clock::duration remainingDuration = duration.first <= last.max ?
+		Clock::duration::zero() : std::max(duration.first - last.expected, Clock::duration::zero());
 
-	return frameMatch;
+	// the frame data follow, don't look for headers in them
+	reset();
+
+	return FrameMatch(type, remainingDuration, duration.second);
 }
 
-SomfyFrameMatcher::SequenceMatcher::SequenceMatcher(const Duration * sequence, size_t sequenceSize):
-	m_sequence(sequence),
-	m_sequenceSize(sequenceSize),
-	m_matchedCount(0)
-{}
+SomfyFrameMatcher::Window SomfyFrameMatcher::makeWindow(const Duration & expected, double tolerance)
+{
+	const Clock::duration e = expected.first;
+
+	// estimate the bounds in ticks ...
+	const double delta = tolerance * e.count();
+	Clock::duration min(static_cast<Clock::rep>(std::floor(e.count() - delta)));
+	Clock::duration max(static_cast<Clock::rep>(std::ceil(e.count() + delta)));
+
+	// ... and move them by single ticks until they agree with the comparisons
+	// done in seconds (these round differently, so the estimate can be off by one)
+	while (!matchDurationAtLeast(min, e, tolerance))
+		++min;
+	while (matchDurationAtLeast(min - Clock::duration(1), e, tolerance))
+		--min;
+	while (max >= min && !matchDuration(max, e, tolerance))
+		--max;
+	while (matchDuration(max + Clock::duration(1), e, tolerance))
+		++max;
+
+	return Window{e, min, max, expected.second};
+}
 
-std::optional<Clock::duration> SomfyFrameMatcher::SequenceMatcher::newTransition(const Duration & duration, double tolerance)
+void SomfyFrameMatcher::addHeader(const Duration * durations, size_t count, SomfyFrameType type, double tolerance)
 {
-	if (m_matchedCount == m_sequenceSize)
-		throw std::runtime_error("SequenceMatcher::newTransition() called too many times w/o a reset!");
-
-	const bool newState = duration.second;
-	const bool expectedNewState = m_sequence[m_matchedCount].second;
-	if (newState == expectedNewState &&
-			((matchDuration(duration.first, m_sequence[m_matchedCount].first, tolerance) ||
-			(m_matchedCount + 1 == m_sequenceSize && matchDurationAtLeast(duration.first, m_sequence[m_matchedCount].first, tolerance))))
-		)
-	{
-		m_matchedCount++;
+	if (count == 0 || m_steps.size() + count > std::numeric_limits<StepMask>::digits)
+		throw std::runtime_error("SomfyFrameMatcher: unsupported header length");
 
-		// TODO: clean this up
-		if (m_matchedCount == m_sequenceSize)
-		{
-			if (matchDuration(duration.first, m_sequence[m_matchedCount-1].first, tolerance))
-				return Clock::duration::zero();
-			else
-				return std::max(duration.first - m_sequence[m_matchedCount-1].first, Clock::duration::zero());
-		}
-		return std::nullopt;
-	}
-	else
-	{
-		reset();
-		return std::nullopt;
-	}
+	m_firstSteps |= StepMask(1) << m_steps.size();
+	for (size_t i = 0; i < count; i++)
+		m_steps.push_back(makeWindow(durations[i], tolerance));
+	m_headers.emplace_back(type, m_steps.size() - 1);
 }
 
-bool SomfyFrameMatcher::SequenceMatcher::matchDuration(Clock::duration actual, Clock::duration expected, double tolerance)
+SomfyFrameMatcher::StepMask SomfyFrameMatcher::getAcceptedSteps(Clock::duration actual, bool state) const
 {
-	const double a = std::chrono::duration<double>(actual).count();
-	const double e = std::chrono::duration<double>(expected).count();
+	StepMask steps = 0;
+	for (size_t header = 0, first = 0; header < m_headers.size(); first = m_headers[header++].second + 1)
+	{
+		const size_t last = m_headers[header].second;
+		for (size_t i = first; i <= last; i++)
+		{
+			const Window & window = m_steps[i];
+			if (window.state == state && actual >= window.min && (actual <= window.max || i == last))
+				steps |= StepMask(1) << i;
+		}
+	}
 
-	return fabs(a - e) < tolerance * e;
+	return steps;
 }
 
-bool SomfyFrameMatcher::SequenceMatcher::matchDurationAtLeast(Clock::duration actual, Clock::duration expected, double tolerance)
+void SomfyFrameMatcher::buildAutomaton()
 {
-	const double a = std::chrono::duration<double>(actual).count();
-	const double e = std::chrono::duration<double>(expected).count();
+	// split the durations of each level into intervals by the window bounds
+	for (size_t i = 0; i < m_steps.size(); i++)
+	{
+		std::vector<Clock::duration> & boundaries = m_boundaries[m_steps[i].state];
+		boundaries.push_back(m_steps[i].min);
+		boundaries.push_back(m_steps[i].max + Clock::duration(1));
+	}
+
+	// the steps each symbol is accepted by
+	std::vector<StepMask> symbolSteps;
+	for (bool state: {false, true})
+	{
+		std::vector<Clock::duration> & boundaries = m_boundaries[state];
+		std::sort(boundaries.begin(), boundaries.end());
+		boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+		// interval k starts at boundaries[k-1] (the first one has no lower bound)
+		symbolSteps.push_back(getAcceptedSteps(Clock::duration::min(), state));
+		for (Clock::duration boundary: boundaries)
+			symbolSteps.push_back(getAcceptedSteps(boundary, state));
+	}
+	m_symbolCount = symbolSteps.size();
+
+	/*
+	 * Subset construction: a state of the automaton is the set of header steps
+	 * matched so far (step i is set if the durations up to now end with steps
+	 * 0 .. i of its header). On a new duration, each of these can be extended
+	 * by the next step and any header can be started anew.
+	 */
+	std::vector<StepMask> states{0};
+	for (size_t i = 0; i < states.size(); i++)
+	{
+		size_t accepting = NO_MATCH;
+		for (size_t header = 0; header < m_headers.size() && accepting == NO_MATCH; header++)
+			if (states[i] & (StepMask(1) << m_headers[header].second))
+				accepting = header;
+		m_accepting.push_back(accepting);
 
-	return a - e > - tolerance * e;
+		for (StepMask steps: symbolSteps)
+		{
+			const StepMask next = ((states[i] << 1) | m_firstSteps) & steps;
+			const size_t index = std::find(states.begin(), states.end(), next) - states.begin();
+			if (index == states.size())
+			{
+				if (index > std::numeric_limits<StateIndex>::max())
+					throw std::runtime_error("SomfyFrameMatcher: too many states");
+				states.push_back(next);
+			}
+			m_table.push_back(static_cast<StateIndex>(index));
+		}
+	}
 }
 
-void SomfyFrameMatcher::SequenceMatcher::reset()
+size_t SomfyFrameMatcher::getSymbol(const Duration & duration) const
 {
-	m_matchedCount = 0;
+	const std::vector<Clock::duration> & boundaries = m_boundaries[duration.second];
+	const size_t interval = std::upper_bound(boundaries.begin(), boundaries.end(), duration.first) - boundaries.begin();
+
+	// the symbols of the false level come first
+	return duration.second ? m_boundaries[false].size() + 1 + interval : interval;
 }
 
 } // namespace rts
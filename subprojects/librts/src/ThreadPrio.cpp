@@ -44,4 +44,29 @@ void setThreadSchedulerAndPrio(std::thread & thread, int schedAlgo)
 		throw std::system_error(errno, std::generic_category(), "pthread_setschedparam failed");
 }
 
+namespace
+{
+	void setAffinity(pthread_t nativeHandle, unsigned cpu)
+	{
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(cpu, &cpuSet);
+
+		// pthread functions return the error code instead of setting errno
+		const int r = pthread_setaffinity_np(nativeHandle, sizeof(cpuSet), &cpuSet);
+		if (r != 0)
+			throw std::system_error(r, std::generic_category(), "pthread_setaffinity_np failed");
+	}
+}
+
+void setThreadAffinity(std::thread & thread, unsigned cpu)
+{
+	setAffinity(thread.native_handle(), cpu);
+}
+
+void setCurrentThreadAffinity(unsigned cpu)
+{
+	setAffinity(pthread_self(), cpu);
+}
+
 } // namespace rts
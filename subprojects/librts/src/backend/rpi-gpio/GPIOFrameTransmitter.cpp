@@ -123,7 +123,7 @@ void GPIOFrameTransmitter::appendFrame(DurationBuffer & buffer, SomfyFrameType f
 
 std::vector<Duration> GPIOFrameTransmitter::getEncodedFramePayload(const SomfyFrame & frame)
 {
-	const std::vector<uint8_t> & bytes = frame.getBytes();
+	const SomfyFrame::Bytes bytes = frame.getByteArray();
 
 	if (m_debugLogger)
 	{
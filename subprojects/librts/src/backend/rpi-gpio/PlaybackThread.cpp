@@ -17,7 +17,7 @@
  * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "backend/rpi-gpio/PlaybackThread.h"
-#include "../../ThreadPrio.h"
+#include "ThreadPrio.h"
 
 #include <sched.h>
 
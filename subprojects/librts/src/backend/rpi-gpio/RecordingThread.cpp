@@ -17,7 +17,7 @@
  * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
  */
 #include "backend/rpi-gpio/RecordingThread.h"
-#include "../../ThreadPrio.h"
+#include "ThreadPrio.h"
 
 #include <sched.h>
 
@@ -29,9 +29,6 @@ namespace rts
 
 using namespace std::literals;
 
-static_assert(std::atomic<Transition*>::is_always_lock_free,
-	"A lock-free atomic pointer required for good performance.");
-
 namespace
 {
 	constexpr std::chrono::steady_clock::duration GET_RETRY_TIME = 100ms;
@@ -41,16 +38,10 @@ RecordingThread::RecordingThread(unsigned gpioNr, size_t bufferSize, const Clock
 	m_gpioNr(gpioNr),
 	m_samplePeriod(samplePeriod),
 	m_readBuffer(bufferSize),
-	// +1 to account for the fact that there's always at least 1 free element in between to differentiate empty and full
-	m_buffer(bufferSize + 1),
+	m_ring(bufferSize),
 	m_running(false),
 	m_stop(false)
-{
-	if (bufferSize == 0)
-		throw std::runtime_error("bufferSize must be positive");
-
-	m_writePtr = m_readPtr = &m_buffer.front();
-}
+{}
 
 void RecordingThread::start()
 {
@@ -88,9 +79,7 @@ std::optional<Transition> RecordingThread::get()
 
 	if (m_readBuffer.empty())
 	{
-		Transition * readPtr = m_readPtr.load(std::memory_order_acquire);
-		Transition * writePtr = m_writePtr.load(std::memory_order_relaxed);
-		while (readPtr == writePtr && m_running)
+		while (m_ring.empty() && m_running)
 		{
 			const auto waitUntil = std::chrono::steady_clock::now() + GET_RETRY_TIME;
 			while (m_running)
@@ -98,27 +87,14 @@ std::optional<Transition> RecordingThread::get()
 				if (m_runningCondVar.wait_until(g, waitUntil) == std::cv_status::timeout)
 					break;
 			}
-
-			readPtr = m_readPtr.load(std::memory_order_acquire);
-			writePtr = m_writePtr.load(std::memory_order_relaxed);
 		}
 
-		if (readPtr == writePtr)
+		if (m_ring.empty())
 			return std::nullopt;
 
 		// read as much data as available
-		// it's guaranteed to fit because m_readBuffer.empty() && m_readBuffer.capacity() == m_buffer.size() - 1
-		// (but it's always guaranteed that there's at least 1 unused element in m_buffer)
-		if (readPtr < writePtr)
-			std::copy(readPtr, writePtr, std::back_inserter(m_readBuffer));
-		else
-		{
-			std::copy(readPtr, &m_buffer.back() + 1, std::back_inserter(m_readBuffer));
-			std::copy(&m_buffer.front(), writePtr, std::back_inserter(m_readBuffer));
-		}
-
-		// mark all as read
-		m_readPtr.store(writePtr, std::memory_order_release);
+		// it's guaranteed to fit because m_readBuffer.empty() && m_readBuffer.capacity() == m_ring.capacity()
+		m_ring.drain(std::back_inserter(m_readBuffer));
 	}
 
 	// return previously received data
@@ -139,7 +115,7 @@ void RecordingThread::recordingLoop()
 	// recording loop
 	Clock::time_point t = Clock::now();
 	bool state = m_gpioReader.read(m_gpioNr);
-	put(t, state);
+	m_ring.put(std::make_pair(t, state));
 
 	while (!m_stop.load(std::memory_order_relaxed))
 	{
@@ -149,32 +125,10 @@ void RecordingThread::recordingLoop()
 		{
 			state = newState;
 			t = now;
-			put(t, state);
+			m_ring.put(std::make_pair(t, state));
 		}
 		std::this_thread::sleep_until(now + m_samplePeriod);
 	}
 }
 
-void RecordingThread::put(const Clock::time_point & tp, bool value)
-{
-	const Transition * const readPtr = m_readPtr.load(std::memory_order_relaxed);
-	Transition * writePtr = m_writePtr.load(std::memory_order_acquire);
-	Transition * advancedWritePtr = advanceBufferPtr(writePtr);
-	if (advancedWritePtr != readPtr)
-	{
-		*writePtr = std::make_pair(tp, value);
-		m_writePtr.store(advancedWritePtr, std::memory_order_release);
-	}
-	// else: drop - no space in buffer
-}
-
-Transition * RecordingThread::advanceBufferPtr(Transition *ptr)
-{
-	ptr++;
-	if (ptr == &m_buffer.back() + 1)
-		ptr = &m_buffer.front();
-
-	return ptr;
-}
-
 } // namespace rts
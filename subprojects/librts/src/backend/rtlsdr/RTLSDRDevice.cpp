@@ -92,4 +92,32 @@ size_t RTLSDRDevice::readSync(uint8_t * buffer, size_t size)
 	return wasRead;
 }
 
+void RTLSDRDevice::readAsync(const AsyncCallback & callback, uint32_t transferCount, uint32_t transferLength)
+{
+	// librtlsdr requires this, see rtlsdr_read_async()
+	if (transferLength % 512 != 0)
+		throw std::runtime_error(std::string("transfer length must be a multiple of 512, got ") + std::to_string(transferLength));
+
+	if (!m_reading)
+	{
+		rtlsdr_reset_buffer(m_device);
+		m_reading = true;
+	}
+
+	if (rtlsdr_read_async(m_device, &RTLSDRDevice::asyncCallback, const_cast<AsyncCallback*>(&callback),
+			transferCount, transferLength) < 0)
+		throw std::runtime_error("rtlsdr_read_async failed");
+}
+
+void RTLSDRDevice::cancelAsync()
+{
+	rtlsdr_cancel_async(m_device);
+}
+
+void RTLSDRDevice::asyncCallback(unsigned char * buffer, uint32_t length, void * context)
+{
+	const AsyncCallback & callback = *static_cast<const AsyncCallback*>(context);
+	callback(buffer, length);
+}
+
 } // namespace rts
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <optional>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#include "backend/rtlsdr/CICDecimator.h"
+
+using namespace rts;
+
+namespace
+{
+	// an IQ source that returns the given data in blocks of the given sizes (cyclically)
+	class BlockSource
+	{
+	public:
+		BlockSource(const std::vector<uint8_t> & iq, const std::vector<size_t> & blockSizes):
+			m_iq(iq),
+			m_blockSizes(blockSizes),
+			m_offset(0),
+			m_blockIndex(0)
+		{}
+
+		std::optional<IQBlock> getBlock()
+		{
+			const size_t remaining = m_iq.size() / 2 - m_offset;
+			if (remaining == 0)
+				return std::nullopt;
+
+			const size_t size = std::min(remaining, m_blockSizes[m_blockIndex++ % m_blockSizes.size()]);
+			const IQBlock block{m_iq.data() + 2*m_offset, size};
+			m_offset += size;
+
+			return block;
+		}
+
+	private:
+		const std::vector<uint8_t> & m_iq;
+		const std::vector<size_t> m_blockSizes;
+		size_t m_offset;
+		size_t m_blockIndex;
+	};
+
+	std::vector<uint8_t> makeRandomIQ(size_t sampleCount)
+	{
+		std::mt19937 generator(7);
+		std::uniform_int_distribution<int> distribution(0, 255);
+
+		std::vector<uint8_t> iq(2*sampleCount);
+		for (uint8_t & b: iq)
+			b = static_cast<uint8_t>(distribution(generator));
+
+		return iq;
+	}
+
+	template<typename Decimator>
+	std::vector<uint8_t> readAll(Decimator & decimator)
+	{
+		std::vector<uint8_t> iq;
+		while (std::optional<IQBlock> block = decimator.getBlock())
+			iq.insert(iq.end(), block->data, block->data + 2*block->size);
+
+		return iq;
+	}
+
+	/*
+	 * The straightforward way: ORDER times a moving sum of decimation samples
+	 * (starting with zeros), then take every decimation-th sample and divide
+	 * it by the gain.
+	 */
+	std::vector<uint8_t> decimateReference(const std::vector<uint8_t> & iq, size_t decimation, size_t order)
+	{
+		std::vector<uint8_t> out;
+		for (size_t c = 0; c < 2; c++)
+		{
+			std::vector<uint64_t> x(iq.size() / 2);
+			for (size_t k = 0; k < x.size(); k++)
+				x[k] = iq[2*k + c];
+
+			for (size_t i = 0; i < order; i++)
+			{
+				std::vector<uint64_t> y(x.size(), 0);
+				for (size_t k = 0; k < x.size(); k++)
+					for (size_t j = 0; j < decimation && j <= k; j++)
+						y[k] += x[k - j];
+				x = y;
+			}
+
+			const uint64_t gain = static_cast<uint64_t>(std::pow(decimation, order));
+			out.resize(2 * (x.size() / decimation));
+			for (size_t m = 0; m < x.size() / decimation; m++)
+				out[2*m + c] = static_cast<uint8_t>((x[m*decimation + decimation - 1] + gain/2) / gain);
+		}
+
+		return out;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestCICDecimator_passThrough)
+{
+	const std::vector<uint8_t> iq = makeRandomIQ(1000);
+	BlockSource source(iq, {100, 33});
+	CICDecimator<BlockSource> decimator(source, 1);
+
+	// the blocks of the source are passed as they are
+	const std::optional<IQBlock> block = decimator.getBlock();
+	BOOST_REQUIRE(block.has_value());
+	BOOST_TEST(block->data == iq.data());
+	BOOST_TEST(block->size == 100u);
+
+	std::vector<uint8_t> out(block->data, block->data + 2*block->size);
+	const std::vector<uint8_t> rest = readAll(decimator);
+	out.insert(out.end(), rest.begin(), rest.end());
+	BOOST_TEST(out == iq);
+}
+
+BOOST_AUTO_TEST_CASE(TestCICDecimator_matchesReference)
+{
+	const std::vector<uint8_t> iq = makeRandomIQ(5000);
+
+	for (size_t decimation: {2, 5, 13})
+	{
+		// uneven blocks, some shorter than decimation, to check the state is carried over
+		BlockSource source1(iq, {1, 700, 3, 64, 1001});
+		CICDecimator<BlockSource, 1> order1(source1, decimation);
+		BOOST_TEST(readAll(order1) == decimateReference(iq, decimation, 1));
+
+		BlockSource source2(iq, {1, 700, 3, 64, 1001});
+		CICDecimator<BlockSource, 2> order2(source2, decimation);
+		BOOST_TEST(readAll(order2) == decimateReference(iq, decimation, 2));
+
+		BlockSource source3(iq, {5000});
+		CICDecimator<BlockSource, 3> order3(source3, decimation);
+		BOOST_TEST(readAll(order3) == decimateReference(iq, decimation, 3));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestCICDecimator_constant)
+{
+	// a constant signal comes out unchanged (after the filter settles)
+	const std::vector<uint8_t> iq = [] {
+		std::vector<uint8_t> iq(2*1300);
+		for (size_t k = 0; k < iq.size(); k += 2)
+		{
+			iq[k] = 228;
+			iq[k + 1] = 28;
+		}
+		return iq;
+	}();
+
+	BlockSource source(iq, {256});
+	CICDecimator<BlockSource> decimator(source, 13);
+	const std::vector<uint8_t> out = readAll(decimator);
+
+	BOOST_TEST(out.size() == 2*100u);
+	for (size_t k = 2*2; k < out.size(); k += 2)
+	{
+		BOOST_TEST_REQUIRE(out[k] == 228);
+		BOOST_TEST_REQUIRE(out[k + 1] == 28);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestCICDecimator_invalidDecimation)
+{
+	const std::vector<uint8_t> iq;
+	BlockSource source(iq, {1});
+
+	BOOST_CHECK_THROW(CICDecimator<BlockSource>(source, 0), std::runtime_error);
+	BOOST_CHECK_NO_THROW((CICDecimator<BlockSource, 2>(source, 4095)));
+	BOOST_CHECK_THROW((CICDecimator<BlockSource, 2>(source, 4096)), std::runtime_error);
+}
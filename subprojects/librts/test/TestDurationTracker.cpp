@@ -80,3 +80,28 @@ BOOST_AUTO_TEST_CASE(TestDurationTracker_twoTransitions)
 	BOOST_TEST(r->first.count() == delta.count()); // count() to make BOOST_TEST happy
 	BOOST_TEST(r->second == true);
 }
+
+BOOST_AUTO_TEST_CASE(TestDurationTracker_glitch)
+{
+	const Clock::time_point t1 = Clock::now();
+
+	TransitionSource source({
+		Transition(t1, true),
+		Transition(t1 + 100us, true), // a glitch, the level stays the same
+		Transition(t1 + 300us, false),
+		Transition(t1 + 700us, true),
+	});
+	DurationTracker<TransitionSource> d(source);
+
+	const std::optional<Duration> r1 = d.get();
+	BOOST_TEST(r1.has_value());
+	BOOST_TEST(r1->first.count() == Clock::duration(300us).count());
+	BOOST_TEST(r1->second == true);
+
+	const std::optional<Duration> r2 = d.get();
+	BOOST_TEST(r2.has_value());
+	BOOST_TEST(r2->first.count() == Clock::duration(400us).count());
+	BOOST_TEST(r2->second == false);
+
+	BOOST_TEST(!d.get().has_value());
+}
@@ -0,0 +1,159 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <chrono>
+#include <optional>
+#include <vector>
+
+#include "backend/rtlsdr/IQFlightRecorder.h"
+#include "backend/rtlsdr/MemoryIQSource.h"
+#include "TestUtils.h"
+
+using namespace rts;
+using namespace std::literals;
+
+namespace
+{
+
+constexpr size_t SAMPLE_RATE = 10000;
+constexpr size_t BLOCK_SIZE = 500;
+
+std::vector<uint8_t> makeIQData(size_t sampleCount)
+{
+	std::vector<uint8_t> data(2*sampleCount);
+	for (size_t i = 0; i < data.size(); i++)
+		data[i] = static_cast<uint8_t>(i * 7 + i / 251);
+
+	return data;
+}
+
+std::vector<uint8_t> getSamples(const std::vector<uint8_t> & data, size_t from, size_t to)
+{
+	return std::vector<uint8_t>(data.begin() + 2*from, data.begin() + 2*to);
+}
+
+Clock::time_point triggerTime(size_t sample)
+{
+	return Clock::time_point() + sampleTime(sample, SAMPLE_RATE);
+}
+
+/*
+ * Pass all data through a recorder and trigger it at the given samples,
+ * a block after the sample has been read (as the decoder lags behind).
+ * Returns the contents of the files written.
+ */
+std::vector<std::vector<uint8_t>> record(const std::vector<uint8_t> & data, const std::vector<size_t> & events)
+{
+	TemporaryFile prefix;
+	{
+		const IQBlock samples{data.data(), data.size() / 2};
+		MemoryIQSource source(samples, BLOCK_SIZE);
+		IQFlightRecorder<MemoryIQSource> recorder(source, SAMPLE_RATE, prefix.getName(), 100ms, 200ms);
+
+		std::vector<uint8_t> passed;
+		size_t position = 0;
+		size_t nextEvent = 0;
+		while (std::optional<IQBlock> block = recorder.getBlock())
+		{
+			passed.insert(passed.end(), block->data, block->data + 2*block->size);
+
+			for (; nextEvent < events.size() && events[nextEvent] < position; nextEvent++)
+				recorder.trigger(triggerTime(events[nextEvent]));
+			position += block->size;
+		}
+		for (; nextEvent < events.size(); nextEvent++)
+			recorder.trigger(triggerTime(events[nextEvent]));
+
+		BOOST_TEST(passed == data);
+
+		// the recorder saves the rest and waits for the files to be written
+	}
+
+	std::vector<std::vector<uint8_t>> captures;
+	for (size_t i = 0; ; i++)
+	{
+		const std::string fileName = prefix.getName() + "-" + std::to_string(i) + ".iq";
+		std::ifstream f(fileName, std::ios::binary);
+		if (!f)
+			break;
+
+		captures.emplace_back(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+		std::remove(fileName.c_str());
+	}
+
+	return captures;
+}
+
+} // unnamed namespace
+
+BOOST_AUTO_TEST_CASE(TestIQFlightRecorder_windows)
+{
+	const std::vector<uint8_t> data = makeIQData(6*SAMPLE_RATE);
+
+	// separate events, overlapping events (merged) and events near the end of data
+	const std::vector<std::vector<uint8_t>> captures = record(data, {10000, 20000, 21500, 50000, 59500});
+
+	BOOST_REQUIRE(captures.size() == 4u);
+	BOOST_TEST(captures[0] == getSamples(data, 9000, 12000));
+	BOOST_TEST(captures[1] == getSamples(data, 19000, 23500));
+	BOOST_TEST(captures[2] == getSamples(data, 49000, 52000));
+	BOOST_TEST(captures[3] == getSamples(data, 58500, 60000));
+}
+
+BOOST_AUTO_TEST_CASE(TestIQFlightRecorder_burst)
+{
+	const std::vector<uint8_t> data = makeIQData(8*SAMPLE_RATE);
+
+	// events during 4 s: more than fits in the ring, saved in consecutive pieces
+	std::vector<size_t> events;
+	for (size_t sample = 10000; sample < 50000; sample += 1000)
+		events.push_back(sample);
+
+	const std::vector<std::vector<uint8_t>> captures = record(data, events);
+
+	BOOST_REQUIRE(captures.size() > 1u);
+	std::vector<uint8_t> joined;
+	for (const std::vector<uint8_t> & c: captures)
+		joined.insert(joined.end(), c.begin(), c.end());
+	BOOST_TEST(joined == getSamples(data, 9000, 51000));
+}
+
+BOOST_AUTO_TEST_CASE(TestIQFlightRecorder_disabled)
+{
+	const std::vector<uint8_t> data = makeIQData(SAMPLE_RATE);
+	const IQBlock samples{data.data(), data.size() / 2};
+	MemoryIQSource source(samples, BLOCK_SIZE);
+	IQFlightRecorder<MemoryIQSource> recorder(source, SAMPLE_RATE, "", 100ms, 200ms);
+
+	BOOST_TEST(!recorder.isEnabled());
+
+	size_t size = 0;
+	while (std::optional<IQBlock> block = recorder.getBlock())
+	{
+		recorder.trigger(triggerTime(size));
+		size += block->size;
+	}
+
+	BOOST_TEST(size == data.size() / 2);
+	BOOST_TEST(recorder.getCaptureCount() == 0u);
+}
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <complex>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "DurationBuffer.h"
+#include "DurationTracker.h"
+#include "SomfyDecoder.h"
+#include "SomfyFrame.h"
+#include "SomfyFrameEncoder.h"
+#include "backend/rtlsdr/IQModulator.h"
+#include "backend/rtlsdr/MemoryIQSource.h"
+#include "backend/rtlsdr/OOKDecoder.h"
+
+#include "TestSignal.h"
+
+using namespace rts;
+using namespace std::literals;
+
+namespace
+{
+	constexpr size_t SAMPLE_RATE = 260000;
+
+	std::vector<uint8_t> render(const std::vector<Duration> & durations, const IQModulatorOptions & options,
+		size_t blockSize = IQModulator::DEFAULT_BLOCK_SIZE)
+	{
+		IQModulator modulator(durations, SAMPLE_RATE, options, blockSize);
+		std::vector<uint8_t> iq;
+		while (const std::optional<IQBlock> block = modulator.getBlock())
+		{
+			BOOST_TEST(block->size <= (blockSize + IQModulator::LANES - 1) / IQModulator::LANES * IQModulator::LANES);
+			iq.insert(iq.end(), block->data, block->data + 2*block->size);
+		}
+
+		BOOST_TEST(iq.size() == 2*modulator.getSampleCount());
+		return iq;
+	}
+
+	std::complex<double> getSample(const std::vector<uint8_t> & iq, size_t index)
+	{
+		return std::complex<double>(iq[2*index] - 127.5, iq[2*index + 1] - 127.5);
+	}
+
+	std::string toString(const std::vector<bool> & bits)
+	{
+		std::string s;
+		for (bool b: bits)
+			s.push_back(b ? '1' : '0');
+		return s;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestIQModulator_decode)
+{
+	const SomfyFrame frame(0xa7, SomfyFrame::Action::down, 0x1234, 0xabcdef);
+
+	DurationBuffer buffer;
+	buffer << Duration(20ms, false);
+	SomfyFrameEncoder::appendTransmission(buffer, frame, 2);
+
+	// a bit of everything
+	IQModulatorOptions options;
+	options.snr = 20;
+	options.frequencyOffset = -20e3;
+	options.jitter = 5us;
+	const std::vector<uint8_t> iq = render(buffer.get(), options);
+
+	typedef OOKDecoder<MemoryIQSource> Decoder;
+	MemoryIQSource source(IQBlock{iq.data(), iq.size() / 2}, 4096);
+	Decoder ookDecoder(source, SAMPLE_RATE);
+	DurationTracker<Decoder> durationTracker(ookDecoder);
+
+	std::vector<std::string> log;
+	SomfyDecoder<DurationTracker<Decoder>, EventLog> decoder(durationTracker, 0.1, EventLog(log));
+	decoder.run();
+
+	std::vector<bool> bits;
+	for (uint8_t byte: frame.getBytes())
+		for (int i = CHAR_BIT - 1; i >= 0; i--)
+			bits.push_back((byte >> i) & 1);
+
+	const std::vector<std::string> expected = {
+		"detected normal", "decoded " + toString(bits),
+		"detected repeat", "decoded " + toString(bits),
+		"detected repeat", "decoded " + toString(bits)
+	};
+	BOOST_TEST(log == expected, boost::test_tools::per_element());
+}
+
+BOOST_AUTO_TEST_CASE(TestIQModulator_signal)
+{
+	// 10 ms off, 10 ms on
+	const std::vector<Duration> durations = {Duration(10ms, false), Duration(10ms, true)};
+	const size_t half = SAMPLE_RATE / 100;
+
+	IQModulatorOptions options;
+	options.snr = 10;
+	options.amplitude = 50;
+	options.frequencyOffset = 13e3;
+	const std::vector<uint8_t> iq = render(durations, options);
+	BOOST_TEST_REQUIRE(iq.size() == 4*half);
+
+	// noise only: the power of the noise matches the SNR
+	double noisePower = 0;
+	std::complex<double> mean = 0;
+	for (size_t i = 0; i < half; i++)
+	{
+		noisePower += std::norm(getSample(iq, i));
+		mean += getSample(iq, i);
+	}
+	noisePower /= half;
+	mean /= static_cast<double>(half);
+	BOOST_TEST(std::abs(mean) < 1.0);
+	BOOST_TEST(noisePower == 50.0 * 50.0 / 10, boost::test_tools::tolerance(0.05));
+
+	// the carrier: its power and frequency (average phase change between samples)
+	double power = 0;
+	std::complex<double> rotation = 0;
+	for (size_t i = half; i < 2*half; i++)
+	{
+		power += std::norm(getSample(iq, i));
+		if (i > half)
+			rotation += getSample(iq, i) * std::conj(getSample(iq, i - 1));
+	}
+	power /= half;
+	BOOST_TEST(power == 50.0 * 50.0 + noisePower, boost::test_tools::tolerance(0.05));
+	BOOST_TEST(std::arg(rotation) * SAMPLE_RATE / (2 * M_PI) == 13e3, boost::test_tools::tolerance(0.02));
+}
+
+BOOST_AUTO_TEST_CASE(TestIQModulator_deterministic)
+{
+	DurationBuffer buffer;
+	SomfyFrameEncoder::appendTransmission(buffer, SomfyFrame(0xa1, SomfyFrame::Action::up, 7, 0x123456), 1);
+
+	IQModulatorOptions options;
+	options.jitter = 10us;
+	const std::vector<uint8_t> iq = render(buffer.get(), options);
+
+	// the output doesn't depend on the block size, only on the seed
+	BOOST_TEST(render(buffer.get(), options, 1000) == iq);
+	BOOST_TEST(render(buffer.get(), options, 4097) == iq);
+
+	options.seed = 2;
+	BOOST_TEST(render(buffer.get(), options) != iq);
+}
@@ -0,0 +1,105 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <system_error>
+
+#include <sys/stat.h>
+
+#include "LogFileWriter.h"
+#include "TestUtils.h"
+
+using namespace rts;
+
+namespace
+{
+
+std::vector<uint8_t> makeData(size_t size)
+{
+	std::vector<uint8_t> data(size);
+	for (size_t i = 0; i < size; i++)
+		data[i] = static_cast<uint8_t>(i * 13 + i / 257);
+
+	return data;
+}
+
+// write data in pieces of various sizes, crossing the chunk boundaries
+void writeInPieces(LogFileWriter & writer, const std::vector<uint8_t> & data)
+{
+	size_t offset = 0;
+	for (size_t i = 0; offset < data.size(); i++)
+	{
+		const size_t size = std::min<size_t>((i % 5) * 100003 + 1, data.size() - offset);
+		writer.write(data.data() + offset, size);
+		offset += size;
+	}
+}
+
+} // unnamed namespace
+
+BOOST_AUTO_TEST_CASE(TestLogFileWriter_write)
+{
+	// not a multiple of the chunk size: the last chunk is partial
+	const std::vector<uint8_t> data = makeData(3*LogFileWriter::CHUNK_SIZE + 12345);
+
+	for (bool directIO: {false, true})
+	{
+		BOOST_TEST_CONTEXT("directIO " << directIO)
+		{
+			TemporaryFile file;
+			{
+				LogFileOptions options;
+				options.directIO = directIO;
+				LogFileWriter writer(file.getName(), options);
+				writeInPieces(writer, data);
+				BOOST_TEST(writer.getSize() == data.size());
+			}
+
+			BOOST_TEST(file.read() == data);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestLogFileWriter_preallocate)
+{
+	const std::vector<uint8_t> data = makeData(LogFileWriter::CHUNK_SIZE + 1000);
+
+	TemporaryFile file;
+	LogFileOptions options;
+	options.preallocate = 16*LogFileWriter::CHUNK_SIZE;
+	LogFileWriter writer(file.getName(), options);
+	writeInPieces(writer, data);
+	writer.close();
+
+	// the preallocated space is released, the file contains just the data
+	struct stat st;
+	BOOST_REQUIRE(stat(file.getName().c_str(), &st) == 0);
+	BOOST_TEST(static_cast<uint64_t>(st.st_blocks) * 512 < options.preallocate);
+	BOOST_TEST(file.read() == data);
+
+	BOOST_CHECK_THROW(writer.write(data.data(), 1), std::system_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestLogFileWriter_openError)
+{
+	BOOST_CHECK_THROW(LogFileWriter("/nonexistent-directory/log.iq"), std::system_error);
+}
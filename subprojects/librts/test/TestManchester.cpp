@@ -21,6 +21,7 @@
 #include <cstdint>
 #include <chrono>
 #include <ostream>
+#include <array>
 
 #include "Clock.h"
 #include "Duration.h"
@@ -77,16 +78,58 @@ namespace
 
 BOOST_AUTO_TEST_CASE(TestManchester_decode)
 {
-	ManchesterDecoder decoder(N_BITS);
+	ManchesterDecoder decoder;
 
 	for (size_t i = 0; i < N_TRANSITIONS; i++)
 		BOOST_TEST(decoder.newTransition(TRANSITIONS[i]));
 
-	const std::vector<bool> bits = decoder.getBits();
-
-	BOOST_TEST(bits.size() == N_BITS);
+	BOOST_TEST(decoder.getDecodedBitsCount() == N_BITS);
 	for (size_t i = 0; i < N_BITS; i++)
-		BOOST_TEST(bits[i] == BITS[i]);
+		BOOST_TEST(decoder.getBit(i) == BITS[i]);
+
+	BOOST_TEST(decoder.getWord() == 0x17u);
+	BOOST_TEST(decoder.getBytes<1>()[0] == 0x17u);
+}
+
+BOOST_AUTO_TEST_CASE(TestManchester_decodeLimit)
+{
+	// room for 7 of the 8 bits only
+	ManchesterDecoder<N_BITS - 1> decoder;
+
+	size_t i = 0;
+	while (i < N_TRANSITIONS && decoder.newTransition(TRANSITIONS[i]))
+		i++;
+
+	// the last bit is completed by the second to last transition
+	BOOST_TEST(i == N_TRANSITIONS - 2);
+	BOOST_TEST(decoder.getDecodedBitsCount() == N_BITS - 1);
+	BOOST_TEST(decoder.getError() != nullptr);
+
+	decoder.reset();
+	BOOST_TEST(decoder.getDecodedBitsCount() == 0);
+	BOOST_TEST(decoder.getError() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(TestManchester_roundTrip)
+{
+	// a whole Somfy frame worth of bits
+	constexpr uint64_t WORD = 0xa7d4b21234569aull;
+	constexpr size_t BITS = 56;
+
+	ManchesterEncoder encoder;
+	for (size_t i = 0; i < BITS; i++)
+		encoder << (((WORD >> (BITS - 1 - i)) & 1) != 0);
+
+	ManchesterDecoder<BITS> decoder;
+	for (const Duration & d: encoder.getDurations())
+		BOOST_TEST(decoder.newTransition(d));
+
+	BOOST_TEST(decoder.getDecodedBitsCount() == BITS);
+	BOOST_TEST(decoder.getWord() == WORD);
+
+	const std::array<uint8_t, 7> bytes = decoder.getBytes<7>();
+	BOOST_TEST(bytes[0] == 0xa7u);
+	BOOST_TEST(bytes[6] == 0x9au);
 }
 
 BOOST_AUTO_TEST_CASE(TestManchester_encode)
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "Clock.h"
+#include "DurationBuffer.h"
+#include "DurationTracker.h"
+#include "SomfyDecoder.h"
+#include "SomfyFrame.h"
+#include "Transition.h"
+#include "backend/rtlsdr/MemoryIQSource.h"
+#include "backend/rtlsdr/OOKDecoder.h"
+
+#include "TestSignal.h"
+#include "TestUtils.h"
+
+using namespace rts;
+using namespace std::literals;
+
+namespace
+{
+	constexpr size_t SAMPLE_RATE = 260000;
+
+	// a frame and two repeats
+	std::vector<Duration> makeTransmission()
+	{
+		const SomfyFrame frame(0xa7, SomfyFrame::Action::up, 0x1234, 0x654321);
+
+		DurationBuffer buffer;
+		buffer << Duration(50ms, false);
+		appendFrame(buffer, SomfyFrameType::normal, frame, SomfyFrame::FRAME_SIZE * CHAR_BIT);
+		appendFrame(buffer, SomfyFrameType::repeat, frame, SomfyFrame::FRAME_SIZE * CHAR_BIT);
+		appendFrame(buffer, SomfyFrameType::repeat, frame, SomfyFrame::FRAME_SIZE * CHAR_BIT);
+		buffer << Duration(50ms, false);
+
+		return buffer.get();
+	}
+
+	// the transitions relative to the time of firstSample
+	std::vector<Transition> getTransitions(const std::vector<uint8_t> & iq, uint64_t firstSample)
+	{
+		MemoryIQSource source(IQBlock{iq.data(), iq.size() / 2}, 4096);
+		OOKDecoder<MemoryIQSource> ookDecoder(source, SAMPLE_RATE, firstSample);
+
+		std::vector<Transition> transitions;
+		while (std::optional<Transition> t = ookDecoder.get())
+			transitions.emplace_back(t->first - sampleTime(firstSample, SAMPLE_RATE), t->second);
+
+		return transitions;
+	}
+
+	std::vector<std::string> decode(const std::vector<uint8_t> & iq, uint64_t firstSample)
+	{
+		typedef OOKDecoder<MemoryIQSource> Decoder;
+
+		MemoryIQSource source(IQBlock{iq.data(), iq.size() / 2}, 4096);
+		Decoder ookDecoder(source, SAMPLE_RATE, firstSample);
+		DurationTracker<Decoder> durationTracker(ookDecoder);
+
+		std::vector<std::string> log;
+		SomfyDecoder<DurationTracker<Decoder>, EventLog> decoder(durationTracker, 0.1, EventLog(log));
+		decoder.run();
+
+		return log;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDecoder_sampleTime)
+{
+	BOOST_TEST(sampleTime(0, 2600000) == Clock::duration::zero());
+	BOOST_TEST(sampleTime(2600000, 2600000) == Clock::duration(1s));
+
+	// 384.6 ns, rounded up
+	BOOST_TEST(sampleTime(1, 2600000) == std::chrono::duration_cast<Clock::duration>(385ns));
+
+	// a year at 2.6 MHz doesn't fit in 32 bits (nor in the mantissa of a double, in ns)
+	const uint64_t year = uint64_t(2600000) * 3600 * 24 * 365;
+	BOOST_TEST(sampleTime(year, 2600000) == Clock::duration(24h * 365));
+	BOOST_TEST(sampleTime(year + 1, 2600000) == Clock::duration(24h * 365) + sampleTime(1, 2600000));
+
+	for (uint64_t sample: {uint64_t(1), uint64_t(7), uint64_t(2599999), year - 1, year + 12345})
+	{
+		BOOST_TEST(sampleCount(sampleTime(sample, 2600000), 2600000) == sample);
+		BOOST_TEST(sampleCount(sampleTime(sample, 200000), 200000) == sample);
+	}
+
+	BOOST_TEST(sampleCount(-1s, 2600000) == 0u);
+	BOOST_TEST(sampleCount(500ms, 2600000) == 1300000u);
+}
+
+/*
+ * A frame received hours into a run has to be decoded the same way as at the
+ * start. The stream is synthetic: the decoder is told that its first sample
+ * is hours from the start, so the sample counter doesn't start at 0.
+ */
+BOOST_AUTO_TEST_CASE(TestOOKDecoder_soak)
+{
+	const std::vector<uint8_t> iq = renderIQ(makeTransmission(), SAMPLE_RATE);
+	const std::vector<Transition> expectedTransitions = getTransitions(iq, 0);
+	const std::vector<std::string> expectedLog = decode(iq, 0);
+
+	BOOST_TEST(expectedTransitions.size() > 3 * SomfyFrame::FRAME_SIZE * CHAR_BIT);
+	BOOST_TEST(countPrefix(expectedLog, "decoded ") == 3u);
+
+	const uint64_t hour = uint64_t(SAMPLE_RATE) * 3600;
+	for (uint64_t firstSample: {3 * hour, 3 * hour + 12345, 1000 * 24 * hour + 1})
+	{
+		BOOST_TEST_CONTEXT("first sample " << firstSample)
+		{
+			const std::vector<Transition> transitions = getTransitions(iq, firstSample);
+			BOOST_TEST_REQUIRE(transitions.size() == expectedTransitions.size());
+
+			// the time stamps are the same up to rounding
+			for (size_t i = 0; i < transitions.size(); i++)
+			{
+				const Clock::duration error = transitions[i].first - expectedTransitions[i].first;
+				BOOST_TEST((error >= -Clock::duration(1) && error <= Clock::duration(1)), "transition " << i << " off by " << error);
+				BOOST_TEST(transitions[i].second == expectedTransitions[i].second);
+			}
+
+			BOOST_TEST(decode(iq, firstSample) == expectedLog, boost::test_tools::per_element());
+		}
+	}
+}
@@ -0,0 +1,445 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+#include <complex>
+#include <random>
+#include <algorithm>
+#include <stdexcept>
+#include <array>
+#include <cmath>
+
+#include "backend/rtlsdr/OOKDemodulator.h"
+#include "backend/rtlsdr/FixedPointOOKDemodulator.h"
+#include "backend/rtlsdr/Filter.h"
+#include "backend/rtlsdr/RTLSDRBufferReader.h"
+
+using namespace rts;
+
+namespace
+{
+	const std::array<float, 2> FILTER_A = { 1.0f, -0.78345f };
+	const std::array<float, 2> FILTER_B = { 0.10828f, 0.10828f };
+	constexpr float THRESHOLD = 1.4142135623730950488f / 2;
+
+	// an odd count so that both the SIMD loop and the scalar tail get exercised
+	constexpr size_t SAMPLE_COUNT = 64*100 + 37;
+
+	std::vector<uint8_t> makeRandomIQ(size_t sampleCount)
+	{
+		std::mt19937 generator(42);
+		std::uniform_int_distribution<int> distribution(0, 255);
+		std::bernoulli_distribution carrier(0.002);
+
+		// random noise with bursts of strong carrier
+		std::vector<uint8_t> iq(2*sampleCount);
+		bool on = false;
+		for (size_t i = 0; i < iq.size(); i++)
+		{
+			if (carrier(generator))
+				on = !on;
+
+			const int noise = distribution(generator) / 8 - 16;
+			iq[i] = static_cast<uint8_t>((on ? (i % 4 < 2 ? 250 : 5) : 128) + (on ? 0 : noise));
+		}
+
+		return iq;
+	}
+
+	// long stretches of weak noise (skipped by the demodulators) with a few pulses
+	std::vector<uint8_t> makeQuietIQ(size_t sampleCount)
+	{
+		std::mt19937 generator(7);
+		std::uniform_int_distribution<int> noise(-16, 16);
+
+		std::vector<uint8_t> iq(2*sampleCount);
+		for (size_t i = 0; i < iq.size(); i++)
+		{
+			const size_t sample = i / 2;
+			const bool on = sample % 30011 > 25000 && sample % 1733 < 900;
+			iq[i] = static_cast<uint8_t>(on ? (i % 4 < 2 ? 250 : 5) : 128 + noise(generator));
+		}
+
+		return iq;
+	}
+
+	bool getBit(const std::vector<uint64_t> & bits, size_t index)
+	{
+		return (bits[index / 64] >> (index % 64)) & 1;
+	}
+
+	// demodulate in uneven blocks (to check the state is carried over), return the indices where the output changes
+	template<typename Demodulator>
+	std::vector<size_t> demodulateTransitions(Demodulator & demodulator, const std::vector<uint8_t> & iq)
+	{
+		const size_t sampleCount = iq.size() / 2;
+		std::vector<size_t> transitions;
+		std::vector<uint64_t> bits;
+		bool last = false;
+		size_t offset = 0;
+		for (size_t blockSize = 1; offset < sampleCount; blockSize = blockSize * 3 + 1)
+		{
+			blockSize = std::min(blockSize, sampleCount - offset);
+			bits.resize((blockSize + 63) / 64);
+			demodulator.process(iq.data() + 2*offset, blockSize, bits.data());
+			for (size_t i = 0; i < blockSize; i++)
+			{
+				if (getBit(bits, i) != last)
+					transitions.push_back(offset + i);
+				last = getBit(bits, i);
+			}
+			offset += blockSize;
+		}
+
+		return transitions;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_simdMatchesScalar)
+{
+	const std::vector<uint8_t> iq = makeRandomIQ(SAMPLE_COUNT);
+
+	OOKDemodulator<SIMDMagnitude> simd(FILTER_A, FILTER_B, THRESHOLD);
+	OOKDemodulator<SIMDMagnitude> scalar(FILTER_A, FILTER_B, THRESHOLD);
+
+	std::vector<uint64_t> simdBits((SAMPLE_COUNT + 63) / 64);
+	std::vector<uint64_t> scalarBits((SAMPLE_COUNT + 63) / 64);
+
+	simd.process(iq.data(), SAMPLE_COUNT, simdBits.data());
+	scalar.processScalar(iq.data(), SAMPLE_COUNT, scalarBits.data());
+
+	BOOST_TEST(simdBits == scalarBits);
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_lutMatchesScalar)
+{
+	const std::vector<uint8_t> iq = makeRandomIQ(SAMPLE_COUNT);
+
+	OOKDemodulator<LUTMagnitude> lut(FILTER_A, FILTER_B, THRESHOLD);
+	OOKDemodulator<LUTMagnitude> scalar(FILTER_A, FILTER_B, THRESHOLD);
+
+	std::vector<uint64_t> lutBits((SAMPLE_COUNT + 63) / 64);
+	std::vector<uint64_t> scalarBits((SAMPLE_COUNT + 63) / 64);
+
+	lut.process(iq.data(), SAMPLE_COUNT, lutBits.data());
+	scalar.processScalar(iq.data(), SAMPLE_COUNT, scalarBits.data());
+
+	BOOST_TEST(lutBits == scalarBits);
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_magnitudeTable)
+{
+	// check all possible samples
+	for (unsigned i = 0; i <= UINT8_MAX; i++)
+	{
+		for (unsigned q = 0; q <= UINT8_MAX; q++)
+		{
+			const float lut = RTLSDRBufferReader::magnitude(i, q);
+			if (lut != ScalarMagnitude::magnitude(i, q))
+				BOOST_FAIL("magnitude mismatch for i=" << i << ", q=" << q);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_matchesFilter)
+{
+	const std::vector<uint8_t> iq = makeRandomIQ(SAMPLE_COUNT);
+
+	// process in several uneven blocks to check the state is carried over
+	OOKDemodulator<> demodulator(FILTER_A, FILTER_B, THRESHOLD);
+	std::vector<uint64_t> bits;
+	std::vector<bool> demodulated;
+	size_t offset = 0;
+	for (size_t blockSize: { 1000, 13, 64, 5000, 1 })
+	{
+		blockSize = std::min(blockSize, SAMPLE_COUNT - offset);
+		bits.resize((blockSize + 63) / 64);
+		demodulator.process(iq.data() + 2*offset, blockSize, bits.data());
+		for (size_t i = 0; i < blockSize; i++)
+			demodulated.push_back(getBit(bits, i));
+		offset += blockSize;
+	}
+	bits.resize((SAMPLE_COUNT - offset + 63) / 64);
+	demodulator.process(iq.data() + 2*offset, SAMPLE_COUNT - offset, bits.data());
+	for (size_t i = 0; i < SAMPLE_COUNT - offset; i++)
+		demodulated.push_back(getBit(bits, i));
+
+	// the way OOKDecoder used to do it, sample by sample
+	Filter filter(FILTER_A, FILTER_B);
+	RTLSDRBufferReader reader;
+	reader.reset(iq.data(), iq.size());
+
+	BOOST_TEST(demodulated.size() == SAMPLE_COUNT);
+	size_t mismatches = 0;
+	size_t ones = 0;
+	for (size_t i = 0; i < SAMPLE_COUNT; i++)
+	{
+		const bool expected = (filter << std::abs(reader.at(i))) >= THRESHOLD;
+		if (expected != demodulated[i])
+			mismatches++;
+		if (expected)
+			ones++;
+	}
+	BOOST_TEST(mismatches == 0);
+
+	// make sure the input is not trivial
+	BOOST_TEST(ones > 0);
+	BOOST_TEST(ones < SAMPLE_COUNT);
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_quietMatchesFilter)
+{
+	const std::vector<uint8_t> iq = makeQuietIQ(200000);
+	const size_t sampleCount = iq.size() / 2;
+
+	for (size_t sampleRate: {2600000, 200000})
+	{
+		const FirstOrderFilterCoefficients coefficients = designLowPassFilter(std::min(100e3, sampleRate / 4.0), sampleRate);
+		OOKDemodulator<> demodulator(coefficients.a, coefficients.b, THRESHOLD);
+		FixedPointOOKDemodulator fixedDemodulator(coefficients.a, coefficients.b, THRESHOLD);
+
+		// the quiet segments are skipped, but for this signal the result is the same
+		// as if computed sample by sample (see quietNearThreshold for the general case)
+		Filter filter(coefficients);
+		RTLSDRBufferReader reader;
+		reader.reset(iq.data(), iq.size());
+		std::vector<size_t> expected;
+		bool last = false;
+		for (size_t i = 0; i < sampleCount; i++)
+		{
+			const bool b = (filter << std::abs(reader.at(i))) >= THRESHOLD;
+			if (b != last)
+				expected.push_back(i);
+			last = b;
+		}
+
+		BOOST_TEST(expected.size() > 10u);
+		BOOST_TEST(demodulateTransitions(demodulator, iq) == expected);
+
+		// and the fixed point one is within a sample, as usual
+		const std::vector<size_t> transitions = demodulateTransitions(fixedDemodulator, iq);
+		BOOST_TEST_REQUIRE(transitions.size() == expected.size());
+		for (size_t i = 0; i < expected.size(); i++)
+			BOOST_TEST(std::abs(static_cast<long>(transitions[i]) - static_cast<long>(expected[i])) <= 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_quietNearThreshold)
+{
+	// quiet stretches (skipped) followed by a carrier so weak that the output
+	// of the filter stays close to the threshold
+	constexpr size_t PERIOD = 4*OOKDemodulator<>::GATE_SIZE;
+	constexpr size_t SAMPLES = 20*PERIOD;
+	std::mt19937 generator(3);
+	std::uniform_int_distribution<int> noise(-16, 16);
+	std::uniform_int_distribution<int> carrier(-1, 1);
+
+	std::vector<uint8_t> iq(2*SAMPLES);
+	for (size_t i = 0; i < iq.size(); i++)
+	{
+		const bool on = (i / 2) % PERIOD >= 3*OOKDemodulator<>::GATE_SIZE;
+		// the magnitude of 192 + 192i is right at the threshold
+		iq[i] = static_cast<uint8_t>(on ? 192 + carrier(generator) : 128 + noise(generator));
+	}
+
+	OOKDemodulator<> demodulator(FILTER_A, FILTER_B, THRESHOLD);
+	std::vector<uint64_t> bits((SAMPLES + 63) / 64);
+	demodulator.process(iq.data(), SAMPLES, bits.data());
+
+	Filter filter(FILTER_A, FILTER_B);
+	RTLSDRBufferReader reader;
+	reader.reset(iq.data(), iq.size());
+
+	// the state after a skipped segment is equivalent within rounding: a bit
+	// can only differ if the output of the filter is at the threshold
+	size_t close = 0;
+	size_t ones = 0;
+	for (size_t i = 0; i < SAMPLES; i++)
+	{
+		const float y = filter << std::abs(reader.at(i));
+		if ((y >= THRESHOLD) != getBit(bits, i))
+			BOOST_TEST(std::abs(y - THRESHOLD) < 1e-5f);
+		if (std::abs(y - THRESHOLD) < 1e-3f)
+			close++;
+		if (y >= THRESHOLD)
+			ones++;
+	}
+
+	// make sure the output is near the threshold often and crosses it
+	BOOST_TEST(close > SAMPLES / 20);
+	BOOST_TEST(ones > 0u);
+	BOOST_TEST(ones < SAMPLES / 2);
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_peak)
+{
+	const std::vector<uint8_t> iq = makeRandomIQ(SAMPLE_COUNT);
+
+	for (size_t offset: {0, 1, 100})
+	{
+		for (size_t count: {0, 1, 7, 8, 64, 1000, 5000})
+		{
+			uint32_t expected = 0;
+			for (size_t i = 2*offset; i < 2*(offset + count); i++)
+				expected = std::max<uint32_t>(expected, std::abs(static_cast<int>(iq[i]) - 128));
+
+			BOOST_TEST(IQPeak::maxDeviation(iq.data() + 2*offset, count) == expected);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_designLowPassFilter)
+{
+	// the coefficients OOKDecoder used to have hard-coded (calculated by Octave's butter())
+	const FirstOrderFilterCoefficients filter = designLowPassFilter(100e3, 2.6e6);
+	BOOST_TEST(filter.a[0] == FILTER_A[0]);
+	BOOST_TEST(filter.a[1] == FILTER_A[1], boost::test_tools::tolerance(1e-4f));
+	BOOST_TEST(filter.b[0] == FILTER_B[0], boost::test_tools::tolerance(1e-4f));
+	BOOST_TEST(filter.b[1] == FILTER_B[1], boost::test_tools::tolerance(1e-4f));
+
+	// unity gain at DC: (b_0 + b_1) / (a_0 + a_1) == 1
+	const FirstOrderFilterCoefficients decimated = designLowPassFilter(50e3, 200e3);
+	BOOST_TEST((decimated.b[0] + decimated.b[1]) / (decimated.a[0] + decimated.a[1]) == 1.0f, boost::test_tools::tolerance(1e-6f));
+
+	BOOST_CHECK_THROW(designLowPassFilter(100e3, 200e3), std::runtime_error);
+
+	// the filter can be designed at compile time, the result matches std::tan() up to rounding
+	// (tan(pi/4) may come out as exactly 1, i.e. a1 as exactly 0)
+	constexpr FirstOrderFilterCoefficients compileTime = designLowPassFilter(100e3, 2.6e6);
+	static_assert(compileTime.a[0] == 1.0f && compileTime.a[1] < 0 && compileTime.b[0] == compileTime.b[1], "");
+	for (double sampleRate: {2.6e6, 1.3e6, 520e3, 200e3, 40e3})
+	{
+		const double cutoff = std::min(100e3, sampleRate / 4);
+		const double k = std::tan(3.14159265358979323846 * cutoff / sampleRate);
+		const FirstOrderFilterCoefficients designed = designLowPassFilter(cutoff, sampleRate);
+		BOOST_TEST(std::abs(designed.a[1] - static_cast<float>((k - 1) / (k + 1))) < 1e-7f);
+		BOOST_TEST(std::abs(designed.b[0] - static_cast<float>(k / (1 + k))) < 1e-7f);
+		BOOST_TEST(std::abs(designed.b[1] - static_cast<float>(k / (1 + k))) < 1e-7f);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_butterworthDesign)
+{
+	using boost::test_tools::tolerance;
+
+	// Octave: [B, A] = butter(2, 0.1)
+	constexpr FilterCoefficients<3, 3> second = ButterworthDesign::lowPass<2>(0.05, 1.0);
+	const std::array<float, 3> secondA = {1.0f, -1.561018f, 0.641352f};
+	const std::array<float, 3> secondB = {0.020083f, 0.040167f, 0.020083f};
+	for (size_t i = 0; i < 3; i++)
+	{
+		BOOST_TEST(second.a[i] == secondA[i], tolerance(1e-5f));
+		BOOST_TEST(second.b[i] == secondB[i], tolerance(1e-4f));
+	}
+
+	// Octave: [B, A] = butter(3, 0.2)
+	const FilterCoefficients<4, 4> third = ButterworthDesign::lowPass<3>(10e3, 100e3);
+	const std::array<float, 4> thirdA = {1.0f, -1.760042f, 1.182893f, -0.278059f};
+	const std::array<float, 4> thirdB = {0.018099f, 0.054297f, 0.054297f, 0.018099f};
+	for (size_t i = 0; i < 4; i++)
+	{
+		BOOST_TEST(third.a[i] == thirdA[i], tolerance(1e-5f));
+		BOOST_TEST(third.b[i] == thirdB[i], tolerance(1e-4f));
+	}
+
+	// the filter has unity gain at DC, so its step response settles at 1
+	Filter<4, 4> filter(third);
+	float y = 0.0f;
+	for (size_t i = 0; i < 200; i++)
+		y = filter << 1.0f;
+	BOOST_TEST(y == 1.0f, tolerance(1e-4f));
+}
+
+template<size_t NA, size_t NB>
+void checkDifferenceEquation(const std::array<float, NA> & a, const std::array<float, NB> & b)
+{
+	Filter filter(a, b);
+
+	std::mt19937 generator(3);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	std::vector<double> x;
+	std::vector<double> y;
+	for (size_t k = 0; k < 100; k++)
+	{
+		x.push_back(distribution(generator));
+		const float output = filter << static_cast<float>(x.back());
+
+		// sum_i a_i*y_{k-i} = sum_i b_i*x_{k-i}
+		double sum = 0;
+		for (size_t i = 0; i < b.size() && i <= k; i++)
+			sum += b[i] * x[k - i];
+		for (size_t i = 1; i < a.size() && i <= k; i++)
+			sum -= a[i] * y[k - i];
+		y.push_back(sum / a[0]);
+
+		BOOST_TEST(output == y.back(), boost::test_tools::tolerance(1e-4));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_filterMatchesDifferenceEquation)
+{
+	// a filter with distinct coefficients, so that any mix-up of the history shows
+	checkDifferenceEquation<3, 4>({2.0f, -0.5f, 0.25f}, {0.5f, 0.25f, -0.125f, 1.0f});
+
+	// FIR, no past outputs
+	checkDifferenceEquation<1, 3>({2.0f}, {0.5f, 0.25f, -0.125f});
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_fixedPointMagnitudeTable)
+{
+	// the table is within rounding of the float magnitude, in Q15
+	const FixedPointOOKDemodulator::MagnitudeTable & table = FixedPointOOKDemodulator::getMagnitudeTable();
+	for (int i = -128; i < 128; i++)
+	{
+		for (int q = -128; q < 128; q++)
+		{
+			const float expected = ScalarMagnitude::magnitude(i + 128, q + 128) * 32768.0f;
+			if (std::abs(table[i*i + q*q] - expected) > 0.5f)
+				BOOST_FAIL("magnitude mismatch for i=" << i << ", q=" << q);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestOOKDemodulator_fixedPointMatchesFloat)
+{
+	const std::vector<uint8_t> iq = makeRandomIQ(64*1000 + 5);
+
+	for (size_t sampleRate: {2600000, 200000})
+	{
+		// the filters OOKDecoder uses without and with decimation
+		const FirstOrderFilterCoefficients filter = designLowPassFilter(std::min(100e3, sampleRate / 4.0), sampleRate);
+		OOKDemodulator<> floatDemodulator(filter.a, filter.b, THRESHOLD);
+		FixedPointOOKDemodulator fixedDemodulator(filter.a, filter.b, THRESHOLD);
+
+		const std::vector<size_t> expected = demodulateTransitions(floatDemodulator, iq);
+		const std::vector<size_t> transitions = demodulateTransitions(fixedDemodulator, iq);
+
+		// the same transitions, each within one sample
+		BOOST_TEST(expected.size() > 10u);
+		BOOST_TEST_REQUIRE(transitions.size() == expected.size());
+		for (size_t i = 0; i < expected.size(); i++)
+			BOOST_TEST(std::abs(static_cast<long>(transitions[i]) - static_cast<long>(expected[i])) <= 1);
+	}
+
+	// coefficients that could overflow the accumulator are refused
+	BOOST_CHECK_THROW(FixedPointOOKDemodulator({1.0f, 0.0f}, {1.0f, 1.0f}, THRESHOLD), std::runtime_error);
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include "DurationBuffer.h"
+#include "DurationTracker.h"
+#include "SomfyDecoder.h"
+#include "SomfyFrame.h"
+#include "backend/rtlsdr/CICDecimator.h"
+#include "backend/rtlsdr/MemoryIQSource.h"
+#include "backend/rtlsdr/OOKDecoder.h"
+#include "backend/rtlsdr/ParallelIQDecoder.h"
+
+#include "TestSignal.h"
+
+using namespace rts;
+using namespace std::literals;
+
+namespace
+{
+	// a few seconds of frames with repeats, uneven gaps and some truncated frames (which are not decoded correctly)
+	std::vector<Duration> makeTransmissions()
+	{
+		std::mt19937 generator(5);
+		std::uniform_int_distribution<int> gap(0, 300);
+
+		DurationBuffer buffer;
+		buffer << Duration(100ms, false);
+		for (uint16_t rollingCode = 0; rollingCode < 12; rollingCode++)
+		{
+			const SomfyFrame frame(0xa0 | (rollingCode & 0xf), SomfyFrame::Action::down, rollingCode, 0x123456);
+
+			// every fourth frame is cut short
+			appendFrame(buffer, SomfyFrameType::normal, frame, rollingCode % 4 == 3 ? 20 : SomfyFrame::FRAME_SIZE * CHAR_BIT);
+			for (uint16_t repeat = 0; repeat < rollingCode % 3; repeat++)
+				appendFrame(buffer, SomfyFrameType::repeat, frame, SomfyFrame::FRAME_SIZE * CHAR_BIT);
+
+			buffer << Duration(std::chrono::milliseconds(gap(generator)), false);
+		}
+		buffer << Duration(100ms, false);
+
+		return buffer.get();
+	}
+
+	std::vector<std::string> decodeSingleThreaded(const std::vector<uint8_t> & iq, size_t sampleRate, size_t decimation)
+	{
+		typedef CICDecimator<MemoryIQSource> Decimator;
+		typedef OOKDecoder<Decimator> Decoder;
+
+		MemoryIQSource source(IQBlock{iq.data(), iq.size() / 2}, 4096);
+		Decimator decimator(source, decimation);
+		Decoder ookDecoder(decimator, sampleRate / decimation);
+		DurationTracker<Decoder> durationTracker(ookDecoder);
+
+		std::vector<std::string> log;
+		SomfyDecoder<DurationTracker<Decoder>, EventLog> decoder(durationTracker, 0.1, EventLog(log));
+		decoder.run();
+
+		return log;
+	}
+
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelIQDecoder_matchesSingleThreaded)
+{
+	// a low sample rate keeps the test fast, everything in the chain adapts to it
+	for (const auto & [sampleRate, decimation]: {std::pair<size_t, size_t>(260000, 1), std::pair<size_t, size_t>(520000, 2)})
+	{
+		const std::vector<uint8_t> iq = renderIQ(makeTransmissions(), sampleRate);
+		const std::vector<std::string> expected = decodeSingleThreaded(iq, sampleRate, decimation);
+
+		// make sure the signal is decodable at all (the truncated frames are decoded in various ways)
+		BOOST_TEST(countPrefix(expected, "detected ") >= 20u);
+		BOOST_TEST(countPrefix(expected, "decoded ") >= 18u);
+
+		for (unsigned threadCount: {1, 3, 8})
+		{
+			// a short overlap gives many chunks, the boundaries fall into frames
+			std::vector<std::string> log;
+			EventLog listener(log);
+			ParallelIQDecoder<> decoder(IQBlock{iq.data(), iq.size() / 2}, sampleRate, decimation, 0.1, threadCount, 150ms);
+			decoder.run(listener);
+
+			BOOST_TEST(log == expected, boost::test_tools::per_element());
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelIQDecoder_noisy)
+{
+	// the noise causes glitches (the same level reported twice), the decoding has to go on after them
+	const size_t sampleRate = 260000;
+	const std::vector<uint8_t> iq = renderIQ(makeTransmissions(), sampleRate, 12.0, 20us);
+	const std::vector<std::string> expected = decodeSingleThreaded(iq, sampleRate, 1);
+
+	BOOST_TEST(countPrefix(expected, "decoded ") >= 10u);
+
+	for (unsigned threadCount: {1, 3, 8})
+	{
+		std::vector<std::string> log;
+		EventLog listener(log);
+		ParallelIQDecoder<> decoder(IQBlock{iq.data(), iq.size() / 2}, sampleRate, 1, 0.1, threadCount, 150ms);
+		decoder.run(listener);
+
+		BOOST_TEST(log == expected, boost::test_tools::per_element());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestParallelIQDecoder_inexactDecimation)
+{
+	// the decimated rate would be truncated, and so would be the time stamps
+	const std::vector<uint8_t> iq(1024);
+	BOOST_CHECK_THROW(ParallelIQDecoder<>(IQBlock{iq.data(), iq.size() / 2}, 2600000, 3, 0.1), std::runtime_error);
+	BOOST_CHECK_THROW(ParallelIQDecoder<>(IQBlock{iq.data(), iq.size() / 2}, 2600000, 0, 0.1), std::runtime_error);
+	BOOST_CHECK_NO_THROW(ParallelIQDecoder<>(IQBlock{iq.data(), iq.size() / 2}, 2600000, 13, 0.1));
+}
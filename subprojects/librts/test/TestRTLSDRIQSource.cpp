@@ -0,0 +1,409 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <string>
+
+#include "backend/rtlsdr/BasicRTLSDRIQSource.h"
+#include "TestUtils.h"
+
+using namespace rts;
+
+namespace
+{
+
+/**
+ * A stand-in for RTLSDRDevice that plays back given IQ data.
+ *
+ * In the async mode it behaves like librtlsdr: it owns transferCount buffers
+ * and each one is reused once the callback for it returns. When the data
+ * is exhausted, readAsync() returns (unless loop is set).
+ */
+class FakeIQDevice
+{
+public:
+	FakeIQDevice(const std::vector<uint8_t> & data, bool loop = false):
+		m_data(data),
+		m_loop(loop),
+		m_offset(0),
+		m_cancelled(false)
+	{}
+
+	size_t readSync(uint8_t * buffer, size_t size)
+	{
+		const size_t wasRead = read(buffer, size);
+		m_syncReads++;
+		return wasRead;
+	}
+
+	void readAsync(const std::function<void(uint8_t * data, size_t size)> & callback, uint32_t transferCount, uint32_t transferLength)
+	{
+		m_buffers.assign(transferCount, std::vector<uint8_t>(transferLength));
+
+		for (size_t i = 0; !m_cancelled.load(); i = (i + 1) % m_buffers.size())
+		{
+			std::vector<uint8_t> & buffer = m_buffers[i];
+			const size_t wasRead = read(buffer.data(), buffer.size());
+			if (wasRead == 0)
+				break;
+
+			callback(buffer.data(), wasRead);
+		}
+	}
+
+	void cancelAsync()
+	{
+		m_cancelled.store(true);
+	}
+
+	// is data one of the buffers used in the async mode?
+	bool ownsBuffer(const uint8_t * data) const
+	{
+		return std::any_of(m_buffers.begin(), m_buffers.end(), [data](const std::vector<uint8_t> & buffer) {
+			return buffer.data() == data;
+		});
+	}
+
+	size_t getSyncReads() const
+	{
+		return m_syncReads;
+	}
+
+private:
+	size_t read(uint8_t * buffer, size_t size)
+	{
+		if (m_loop && m_offset == m_data.size())
+			m_offset = 0;
+
+		const size_t count = std::min(size, m_data.size() - m_offset);
+		std::copy_n(m_data.begin() + m_offset, count, buffer);
+		m_offset += count;
+
+		return count;
+	}
+
+	const std::vector<uint8_t> & m_data;
+	const bool m_loop;
+	size_t m_offset;
+	size_t m_syncReads = 0;
+	std::atomic<bool> m_cancelled;
+	std::vector<std::vector<uint8_t>> m_buffers;
+};
+
+/**
+ * A stand-in for LogFileWriter that collects the data in memory. Writes
+ * block while the log is held, as if written to a very slow device.
+ */
+class SlowLog
+{
+public:
+	SlowLog(const std::string &, const LogFileOptions &)
+	{
+		s_instance = this;
+	}
+
+	void write(const uint8_t * data, size_t size)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_pendingWrites++;
+		m_cv.notify_all();
+		m_cv.wait(lock, [this]() { return !m_held; });
+
+		m_data.insert(m_data.end(), data, data + size);
+		m_pendingWrites--;
+	}
+
+	void close()
+	{
+		std::lock_guard<std::mutex> g(m_mutex);
+		s_closedData = m_data;
+	}
+
+	bool isDirectIO() const
+	{
+		return false;
+	}
+
+	void hold(bool held)
+	{
+		std::lock_guard<std::mutex> g(m_mutex);
+		m_held = held;
+		m_cv.notify_all();
+	}
+
+	// wait until a write is blocked
+	void waitForPendingWrite()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cv.wait(lock, [this]() { return m_pendingWrites > 0; });
+	}
+
+	size_t getPendingWrites()
+	{
+		std::lock_guard<std::mutex> g(m_mutex);
+		return m_pendingWrites;
+	}
+
+	bool isEmpty()
+	{
+		std::lock_guard<std::mutex> g(m_mutex);
+		return m_data.empty();
+	}
+
+	// the log created by the source
+	static SlowLog * s_instance;
+	// what the log contained when it was closed
+	static std::vector<uint8_t> s_closedData;
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_held = true;
+	size_t m_pendingWrites = 0;
+	std::vector<uint8_t> m_data;
+};
+
+SlowLog * SlowLog::s_instance = nullptr;
+std::vector<uint8_t> SlowLog::s_closedData;
+
+std::vector<uint8_t> makeIQData(size_t size)
+{
+	std::vector<uint8_t> data(size);
+	for (size_t i = 0; i < size; i++)
+		data[i] = static_cast<uint8_t>(i * 7 + i / 251);
+
+	return data;
+}
+
+void appendBlock(std::vector<uint8_t> & received, const IQBlock & block)
+{
+	received.insert(received.end(), block.data, block.data + 2*block.size);
+}
+
+} // unnamed namespace
+
+BOOST_AUTO_TEST_CASE(TestRTLSDRIQSource_sync)
+{
+	constexpr size_t BUFFER_SIZE = 1024;
+	const std::vector<uint8_t> data = makeIQData(10*BUFFER_SIZE);
+	// loop so that the device never returns less than requested
+	FakeIQDevice device(data, true);
+	BasicRTLSDRIQSource<FakeIQDevice> source(device, BUFFER_SIZE, 3, "");
+
+	source.start();
+
+	std::vector<uint8_t> received;
+	while (received.size() < data.size())
+	{
+		std::optional<IQBlock> block = source.getBlock();
+		BOOST_REQUIRE(block.has_value());
+		BOOST_TEST(!device.ownsBuffer(block->data));
+		appendBlock(received, *block);
+	}
+
+	source.stop();
+
+	// what has been recorded before stop() can still be obtained, but no more
+	size_t remaining = 0;
+	while (std::optional<IQBlock> block = source.getBlock())
+	{
+		appendBlock(received, *block);
+		remaining++;
+	}
+	BOOST_TEST(remaining <= 3);
+
+	for (size_t i = 0; i < received.size(); i++)
+		BOOST_TEST_REQUIRE(received[i] == data[i % data.size()]);
+}
+
+BOOST_AUTO_TEST_CASE(TestRTLSDRIQSource_async)
+{
+	constexpr size_t BUFFER_SIZE = 1024;
+	// the last block is a partial one
+	const std::vector<uint8_t> data = makeIQData(10*BUFFER_SIZE + 100);
+	FakeIQDevice device(data);
+	BasicRTLSDRIQSource<FakeIQDevice> source(device, BUFFER_SIZE, 3, "",
+		BasicRTLSDRIQSource<FakeIQDevice>::ReadMode::async);
+
+	source.start();
+
+	// the device stops at the end of data, this ends the source too
+	std::vector<uint8_t> received;
+	while (std::optional<IQBlock> block = source.getBlock())
+	{
+		// the device's buffers are passed through without copying
+		BOOST_TEST(device.ownsBuffer(block->data));
+		appendBlock(received, *block);
+	}
+
+	source.stop();
+
+	BOOST_TEST(received == data);
+	BOOST_TEST(device.getSyncReads() == 0);
+}
+
+BOOST_AUTO_TEST_CASE(TestRTLSDRIQSource_asyncStop)
+{
+	constexpr size_t BUFFER_SIZE = 512;
+	const std::vector<uint8_t> data = makeIQData(7*BUFFER_SIZE);
+	FakeIQDevice device(data, true);
+	BasicRTLSDRIQSource<FakeIQDevice> source(device, BUFFER_SIZE, 4, "",
+		BasicRTLSDRIQSource<FakeIQDevice>::ReadMode::async);
+
+	source.start();
+
+	std::vector<uint8_t> received;
+	std::thread stopThread;
+	while (std::optional<IQBlock> block = source.getBlock())
+	{
+		appendBlock(received, *block);
+
+		// stop from another thread (as on SIGINT) while a block is in use
+		if (received.size() == 3*data.size())
+			stopThread = std::thread([&source]() { source.stop(); });
+	}
+
+	stopThread.join();
+
+	// the data is looped, nothing is lost or reordered
+	BOOST_TEST(received.size() >= 3*data.size());
+	for (size_t i = 0; i < received.size(); i++)
+		BOOST_TEST_REQUIRE(received[i] == data[i % data.size()]);
+}
+
+BOOST_AUTO_TEST_CASE(TestRTLSDRIQSource_destroyWhileRecording)
+{
+	const std::vector<uint8_t> data = makeIQData(4096);
+	FakeIQDevice device(data, true);
+
+	// the consumer gives up while it holds a block, the device must not be left waiting for it
+	{
+		BasicRTLSDRIQSource<FakeIQDevice> source(device, 512, 2, "",
+			BasicRTLSDRIQSource<FakeIQDevice>::ReadMode::async);
+		source.start();
+		BOOST_TEST(source.getBlock().has_value());
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestRTLSDRIQSource_logSync)
+{
+	constexpr size_t BUFFER_SIZE = 4096;
+	const std::vector<uint8_t> data = makeIQData(10*BUFFER_SIZE);
+	FakeIQDevice device(data, true);
+	TemporaryFile log;
+
+	std::vector<uint8_t> received;
+	{
+		BasicRTLSDRIQSource<FakeIQDevice> source(device, BUFFER_SIZE, 3, log.getName());
+		source.start();
+
+		while (received.size() < 3*data.size())
+		{
+			std::optional<IQBlock> block = source.getBlock();
+			BOOST_REQUIRE(block.has_value());
+			appendBlock(received, *block);
+		}
+
+		source.stop();
+		while (std::optional<IQBlock> block = source.getBlock())
+			appendBlock(received, *block);
+	}
+
+	// everything the consumer got has been logged
+	BOOST_TEST(log.read() == received);
+}
+
+BOOST_AUTO_TEST_CASE(TestRTLSDRIQSource_logAsync)
+{
+	constexpr size_t BUFFER_SIZE = 1024;
+	const std::vector<uint8_t> data = makeIQData(100*BUFFER_SIZE + 100);
+	FakeIQDevice device(data);
+	TemporaryFile log;
+
+	std::vector<uint8_t> received;
+	{
+		LogFileOptions logOptions;
+		logOptions.directIO = true;
+		logOptions.preallocate = 1024*1024;
+		BasicRTLSDRIQSource<FakeIQDevice> source(device, BUFFER_SIZE, 4, log.getName(),
+			BasicRTLSDRIQSource<FakeIQDevice>::ReadMode::async, logOptions);
+		source.start();
+
+		// the device's buffers are reused only after they have been logged
+		while (std::optional<IQBlock> block = source.getBlock())
+			appendBlock(received, *block);
+	}
+
+	BOOST_TEST(received == data);
+	BOOST_TEST(log.read() == data);
+}
+
+BOOST_AUTO_TEST_CASE(TestRTLSDRIQSource_logAsyncSlow)
+{
+	constexpr size_t BUFFER_SIZE = 1024;
+	constexpr size_t BUFFER_COUNT = 4;
+	const std::vector<uint8_t> data = makeIQData(20*BUFFER_SIZE);
+	FakeIQDevice device(data);
+
+	typedef BasicRTLSDRIQSource<FakeIQDevice, SlowLog> Source;
+	std::vector<uint8_t> received;
+	{
+		Source source(device, BUFFER_SIZE, BUFFER_COUNT, "slow", Source::ReadMode::async);
+		SlowLog & log = *SlowLog::s_instance;
+		source.start();
+
+		// the first block gets stuck in the log ...
+		std::optional<IQBlock> block = source.getBlock();
+		BOOST_REQUIRE(block.has_value());
+		appendBlock(received, *block);
+		block = source.getBlock();
+		BOOST_REQUIRE(block.has_value());
+		appendBlock(received, *block);
+		log.waitForPendingWrite();
+
+		// ... but the consumer keeps getting blocks until all copies wait to be written
+		for (size_t i = 0; i < BUFFER_COUNT - 1; i++)
+		{
+			block = source.getBlock();
+			BOOST_REQUIRE(block.has_value());
+			BOOST_TEST(device.ownsBuffer(block->data));
+			appendBlock(received, *block);
+		}
+		BOOST_TEST(log.getPendingWrites() == 1);
+		BOOST_TEST(log.isEmpty());
+
+		log.hold(false);
+		while ((block = source.getBlock()))
+			appendBlock(received, *block);
+	}
+
+	// the log has been closed by the source
+	BOOST_TEST(received == data);
+	BOOST_TEST(SlowLog::s_closedData == data);
+}
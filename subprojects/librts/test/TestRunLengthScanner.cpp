@@ -0,0 +1,198 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <random>
+#include <ostream>
+#include <vector>
+
+#include "backend/rtlsdr/RunLengthScanner.h"
+
+using namespace rts;
+
+namespace
+{
+	struct Edge
+	{
+		uint64_t sample;
+		bool value;
+
+		bool operator==(const Edge & other) const
+		{
+			return sample == other.sample && value == other.value;
+		}
+	};
+
+	std::ostream & operator<<(std::ostream & os, const Edge & edge)
+	{
+		return os << edge.sample << (edge.value ? " -> 1" : " -> 0");
+	}
+
+	typedef std::vector<Edge> Transitions;
+
+	// the sample by sample search OOKDecoder used to do
+	Transitions findTransitionsReference(const std::vector<bool> & bits, size_t minSamples)
+	{
+		Transitions transitions;
+		std::optional<bool> lastValue;
+		size_t count = 0;
+		bool startValue = false;
+		uint64_t startIndex = 0;
+
+		for (size_t i = 0; i < bits.size(); i++)
+		{
+			const bool b = bits[i];
+			if (count > 0)
+			{
+				if (b == startValue)
+				{
+					count++;
+					if (count == minSamples)
+					{
+						lastValue = startValue;
+						transitions.push_back(Edge{startIndex, startValue});
+						count = 0;
+					}
+				}
+				else
+				{
+					// early transition - reset
+					count = 1;
+					startValue = b;
+				}
+			}
+			else if (b != lastValue)
+			{
+				count = 1;
+				startValue = b;
+				startIndex = i;
+			}
+		}
+
+		return transitions;
+	}
+
+	// scan bits split into blocks of random sizes
+	Transitions findTransitions(const std::vector<bool> & bits, size_t minSamples, std::mt19937 & generator)
+	{
+		std::uniform_int_distribution<size_t> blockSize(1, 700);
+
+		Transitions transitions;
+		RunLengthScanner scanner(minSamples);
+		for (size_t first = 0; first < bits.size(); )
+		{
+			const size_t size = std::min(blockSize(generator), bits.size() - first);
+
+			// garbage after the end of the block must not matter
+			std::vector<uint64_t> words((size + 63) / 64 + 1, 0x5a5a5a5a5a5a5a5a);
+			for (size_t i = 0; i < size; i++)
+				if (bits[first + i])
+					words[i / 64] |= uint64_t(1) << (i % 64);
+				else
+					words[i / 64] &= ~(uint64_t(1) << (i % 64));
+
+			size_t offset = 0;
+			while (offset < size)
+			{
+				const std::optional<RunLengthScanner::Transition> t = scanner.scan(words.data(), size, offset, first);
+				if (t)
+					transitions.push_back(Edge{t->sample, t->value});
+			}
+
+			first += size;
+		}
+
+		return transitions;
+	}
+
+	// runs of random lengths around minSamples, so there are both glitches and transitions
+	std::vector<bool> makeBits(size_t count, size_t minSamples, std::mt19937 & generator)
+	{
+		std::geometric_distribution<size_t> runLength(1.0 / minSamples);
+		std::bernoulli_distribution longRun(0.05);
+
+		std::vector<bool> bits;
+		bool value = generator() & 1;
+		while (bits.size() < count)
+		{
+			const size_t length = 1 + runLength(generator) + (longRun(generator) ? 500 : 0);
+			bits.insert(bits.end(), std::min(length, count - bits.size()), value);
+			value = !value;
+		}
+
+		return bits;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestRunLengthScanner_fuzz)
+{
+	std::mt19937 generator(11);
+	std::uniform_int_distribution<size_t> minSamplesDistribution(2, 150);
+
+	for (unsigned iteration = 0; iteration < 300; iteration++)
+	{
+		const size_t minSamples = minSamplesDistribution(generator);
+		const std::vector<bool> bits = makeBits(20000, minSamples, generator);
+
+		BOOST_TEST_CONTEXT("iteration " << iteration << ", minSamples " << minSamples)
+		{
+			const Transitions expected = findTransitionsReference(bits, minSamples);
+			BOOST_TEST(expected.size() > 5u);
+			const Transitions actual = findTransitions(bits, minSamples, generator);
+			BOOST_TEST(actual == expected, boost::test_tools::per_element());
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestRunLengthScanner_steady)
+{
+	// a block of one value gives a single transition at its start
+	const std::vector<uint64_t> ones(16, ~uint64_t(0));
+	RunLengthScanner scanner(40);
+
+	size_t offset = 0;
+	std::optional<RunLengthScanner::Transition> t = scanner.scan(ones.data(), 1000, offset, 5000);
+	BOOST_TEST_REQUIRE(t.has_value());
+	BOOST_TEST(t->sample == 5000u);
+	BOOST_TEST(t->value == true);
+	BOOST_TEST(offset == 40u);
+
+	t = scanner.scan(ones.data(), 1000, offset, 5000);
+	BOOST_TEST(!t.has_value());
+	BOOST_TEST(offset == 1000u);
+}
+
+BOOST_AUTO_TEST_CASE(TestRunLengthScanner_minSamplesOne)
+{
+	// every change is a transition
+	const std::vector<uint64_t> bits = {0xf0f0};
+	RunLengthScanner scanner(1);
+
+	Transitions transitions;
+	size_t offset = 0;
+	while (offset < 16)
+		if (const std::optional<RunLengthScanner::Transition> t = scanner.scan(bits.data(), 16, offset, 0))
+			transitions.push_back(Edge{t->sample, t->value});
+
+	const Transitions expected = {{0, false}, {4, true}, {8, false}, {12, true}};
+	BOOST_TEST(transitions == expected, boost::test_tools::per_element());
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <thread>
+
+#include "SPSCQueue.h"
+
+using namespace rts;
+
+BOOST_AUTO_TEST_CASE(TestSPSCQueue_fifo)
+{
+	SPSCQueue<int> queue(3);
+
+	BOOST_TEST(!queue.tryPop().has_value());
+
+	BOOST_TEST(queue.tryPush(1));
+	BOOST_TEST(queue.tryPush(2));
+	BOOST_TEST(queue.tryPush(3));
+	BOOST_TEST(!queue.tryPush(4)); // full
+
+	BOOST_TEST(*queue.tryPop() == 1);
+	BOOST_TEST(queue.tryPush(4));
+	BOOST_TEST(*queue.tryPop() == 2);
+	BOOST_TEST(*queue.tryPop() == 3);
+	BOOST_TEST(*queue.tryPop() == 4);
+	BOOST_TEST(!queue.tryPop().has_value());
+}
+
+BOOST_AUTO_TEST_CASE(TestSPSCQueue_close)
+{
+	SPSCQueue<std::unique_ptr<int>> queue(2);
+
+	BOOST_TEST(queue.push(std::make_unique<int>(1)));
+	queue.close();
+
+	// remaining elements can still be popped, then it's the end
+	BOOST_TEST(!queue.push(std::make_unique<int>(2)));
+	std::optional<std::unique_ptr<int>> value = queue.pop();
+	BOOST_TEST(value.has_value());
+	BOOST_TEST(**value == 1);
+	BOOST_TEST(!queue.pop().has_value());
+}
+
+BOOST_AUTO_TEST_CASE(TestSPSCQueue_closeWakesConsumer)
+{
+	SPSCQueue<int> queue(2);
+
+	std::thread consumer([&queue]() {
+		BOOST_TEST(!queue.pop().has_value());
+	});
+
+	queue.close();
+	consumer.join();
+}
+
+BOOST_AUTO_TEST_CASE(TestSPSCQueue_twoThreads)
+{
+	constexpr size_t COUNT = 200000;
+	SPSCQueue<size_t> queue(7);
+
+	// the producer has to wait when the queue is full, the consumer when it's empty
+	std::thread producer([&queue]() {
+		for (size_t i = 0; i < COUNT; i++)
+			queue.push(size_t(i));
+		queue.close();
+	});
+
+	size_t expected = 0;
+	bool ordered = true;
+	while (std::optional<size_t> value = queue.pop())
+	{
+		if (*value != expected)
+			ordered = false;
+		expected++;
+	}
+
+	producer.join();
+
+	BOOST_TEST(ordered);
+	BOOST_TEST(expected == COUNT);
+}
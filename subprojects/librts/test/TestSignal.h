@@ -0,0 +1,109 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TEST_SIGNAL_H
+#define TEST_SIGNAL_H
+
+#include <cstdint>
+#include <cstddef>
+#include <optional>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include "Clock.h"
+#include "Duration.h"
+#include "DurationBuffer.h"
+#include "SomfyFrame.h"
+#include "SomfyFrameEncoder.h"
+#include "SomfyFrameEvent.h"
+#include "SomfyFrameType.h"
+#include "backend/rtlsdr/IQBlock.h"
+#include "backend/rtlsdr/IQModulator.h"
+
+// synthetic Somfy signals for the tests of the decoding chain
+
+// a frame followed by the inter-frame gap, bitCount can cut the frame short
+inline void appendFrame(rts::DurationBuffer & buffer, rts::SomfyFrameType frameType, const rts::SomfyFrame & frame, size_t bitCount)
+{
+	rts::SomfyFrameEncoder::appendFrame(buffer, frameType, frame, bitCount);
+	buffer << rts::SomfyFrameEncoder::INTER_FRAME_GAP;
+}
+
+// render durations as an OOK modulated carrier with noise in the raw rtl-sdr format
+inline std::vector<uint8_t> renderIQ(const std::vector<rts::Duration> & durations, size_t sampleRate,
+	double snr = 20.0, rts::Clock::duration jitter = rts::Clock::duration::zero())
+{
+	rts::IQModulatorOptions options;
+	options.frequencyOffset = sampleRate / 400.0;
+	options.snr = snr;
+	options.jitter = jitter;
+
+	rts::IQModulator modulator(durations, sampleRate, options);
+	std::vector<uint8_t> iq;
+	while (const std::optional<rts::IQBlock> block = modulator.getBlock())
+		iq.insert(iq.end(), block->data, block->data + 2*block->size);
+
+	return iq;
+}
+
+// SomfyDecoder listener that describes the events as strings
+class EventLog
+{
+public:
+	EventLog(std::vector<std::string> & log):
+		m_log(&log)
+	{}
+
+	void onEvent(const rts::SomfyFrameEvent & event)
+	{
+		switch (event.type)
+		{
+		case rts::SomfyFrameEvent::Type::frameDetected:
+			m_log->push_back(std::string("detected ") + (event.frameType == rts::SomfyFrameType::normal ? "normal" : "repeat"));
+			break;
+		case rts::SomfyFrameEvent::Type::frameDecoded:
+			m_log->push_back("decoded " + toString(event));
+			break;
+		case rts::SomfyFrameEvent::Type::frameDecodeError:
+			m_log->push_back("error " + toString(event));
+			break;
+		}
+	}
+
+private:
+	static std::string toString(const rts::SomfyFrameEvent & event)
+	{
+		std::string s;
+		for (size_t i = 0; i < event.bitCount; i++)
+			s.push_back(event.getBit(i) ? '1' : '0');
+		return s;
+	}
+
+	std::vector<std::string> * m_log;
+};
+
+// the number of log entries starting with prefix
+inline size_t countPrefix(const std::vector<std::string> & log, const std::string & prefix)
+{
+	return std::count_if(log.begin(), log.end(), [&prefix](const std::string & s) {
+		return s.compare(0, prefix.size(), prefix) == 0;
+	});
+}
+
+#endif // TEST_SIGNAL_H
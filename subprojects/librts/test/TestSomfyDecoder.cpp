@@ -0,0 +1,227 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <vector>
+#include <array>
+#include <optional>
+#include <climits>
+#include <cstdint>
+#include <string>
+
+#include "Clock.h"
+#include "Duration.h"
+#include "DurationBuffer.h"
+#include "DurationTracker.h"
+#include "ManchesterEncoder.h"
+#include "SomfyDecoder.h"
+#include "SomfyFrame.h"
+#include "SomfyFrameEvent.h"
+#include "SomfyFrameEncoder.h"
+#include "SomfyFrameHeader.h"
+#include "SomfyFrameType.h"
+#include "Transition.h"
+
+#include "TestSignal.h"
+
+using namespace std::literals;
+using namespace rts;
+
+namespace
+{
+	const Clock::time_point START = Clock::time_point(1h);
+
+	// the durations as transitions starting at START
+	class TransitionSource
+	{
+	public:
+		TransitionSource(const std::vector<Duration> & durations)
+		{
+			Clock::time_point t = START;
+			for (const Duration & d: durations)
+			{
+				m_transitions.emplace_back(t, d.second);
+				t += d.first;
+			}
+			m_transitions.emplace_back(t, !durations.back().second);
+		}
+
+		std::optional<Transition> get()
+		{
+			if (m_index == m_transitions.size())
+				return std::nullopt;
+
+			return m_transitions[m_index++];
+		}
+
+		Clock::time_point getEnd() const
+		{
+			return m_transitions.back().first;
+		}
+
+	private:
+		std::vector<Transition> m_transitions;
+		size_t m_index = 0;
+	};
+
+	class EventRecorder
+	{
+	public:
+		EventRecorder(std::vector<SomfyFrameEvent> & events):
+			m_events(&events)
+		{}
+
+		void onEvent(const SomfyFrameEvent & event)
+		{
+			m_events->push_back(event);
+		}
+
+	private:
+		std::vector<SomfyFrameEvent> * m_events;
+	};
+
+	std::vector<SomfyFrameEvent> decode(const std::vector<Duration> & durations, Clock::time_point * end = nullptr)
+	{
+		TransitionSource source(durations);
+		DurationTracker<TransitionSource> tracker(source);
+		std::vector<SomfyFrameEvent> events;
+		SomfyDecoder<DurationTracker<TransitionSource>, EventRecorder> decoder(tracker, 0.1, EventRecorder(events));
+		decoder.run();
+
+		if (end)
+			*end = source.getEnd();
+		return events;
+	}
+
+	std::vector<uint8_t> toVector(const std::array<uint8_t, SomfyFrame::FRAME_SIZE> & bytes)
+	{
+		return std::vector<uint8_t>(bytes.begin(), bytes.end());
+	}
+
+	const SomfyFrame FRAME(0xa7, SomfyFrame::Action::down, 0x1234, 0x56789a);
+}
+
+BOOST_AUTO_TEST_CASE(TestSomfyDecoder_frameDecoded)
+{
+	DurationBuffer buffer;
+	buffer << Duration(20ms, false);
+	appendFrame(buffer, SomfyFrameType::repeat, FRAME, SomfyFrame::FRAME_SIZE * CHAR_BIT);
+
+	Clock::time_point end;
+	const std::vector<SomfyFrameEvent> events = decode(buffer.get(), &end);
+	BOOST_TEST_REQUIRE(events.size() == 2);
+
+	const SomfyFrameEvent & detected = events[0];
+	BOOST_TEST((detected.type == SomfyFrameEvent::Type::frameDetected));
+	BOOST_TEST((detected.frameType == SomfyFrameType::repeat));
+	BOOST_TEST((detected.time > START + 20ms));
+	BOOST_TEST(detected.bitCount == 0);
+	BOOST_TEST(!detected.frame.has_value());
+
+	const SomfyFrameEvent & decoded = events[1];
+	BOOST_TEST((decoded.type == SomfyFrameEvent::Type::frameDecoded));
+	BOOST_TEST((decoded.frameType == SomfyFrameType::repeat));
+	BOOST_TEST((decoded.time > detected.time));
+	BOOST_TEST((decoded.time <= end));
+	BOOST_TEST(decoded.bitCount == SomfyFrame::FRAME_SIZE * CHAR_BIT);
+	BOOST_TEST(toVector(decoded.bytes) == FRAME.getBytes());
+	BOOST_TEST_REQUIRE(decoded.frame.has_value());
+	BOOST_TEST(decoded.frame->getKey() == FRAME.getKey());
+	BOOST_TEST((decoded.frame->getCtrl() == FRAME.getCtrl()));
+	BOOST_TEST(decoded.frame->getRollingCode() == FRAME.getRollingCode());
+	BOOST_TEST(decoded.frame->getAddress() == FRAME.getAddress());
+	BOOST_TEST(!decoded.error);
+}
+
+BOOST_AUTO_TEST_CASE(TestSomfyDecoder_wrongChecksum)
+{
+	// flipping a bit of the last byte breaks the checksum
+	std::vector<uint8_t> bytes = FRAME.getBytes();
+	bytes.back() ^= 0x10;
+
+	DurationBuffer buffer;
+	buffer << Duration(20ms, false);
+	for (size_t i = 0; i < SOMFY_HEADER_NORMAL.count; i++)
+		buffer << SOMFY_HEADER_NORMAL.durations[i];
+
+	ManchesterEncoder encoder;
+	for (size_t i = 0; i < bytes.size() * CHAR_BIT; i++)
+		encoder << (((bytes[i / CHAR_BIT] << (i % CHAR_BIT)) & 0x80) != 0);
+	for (const Duration & d: encoder.getDurations())
+		buffer << d;
+	buffer << Duration(30ms, false);
+
+	const std::vector<SomfyFrameEvent> events = decode(buffer.get());
+	BOOST_TEST_REQUIRE(events.size() == 2);
+	BOOST_TEST((events[1].type == SomfyFrameEvent::Type::frameDecoded));
+	BOOST_TEST(toVector(events[1].bytes) == bytes);
+	BOOST_TEST(!events[1].frame.has_value());
+	BOOST_TEST(events[1].error);
+}
+
+BOOST_AUTO_TEST_CASE(TestSomfyDecoder_decodeError)
+{
+	// a frame cut short, the gap after it breaks the Manchester code
+	DurationBuffer buffer;
+	buffer << Duration(20ms, false);
+	appendFrame(buffer, SomfyFrameType::normal, FRAME, 24);
+	appendFrame(buffer, SomfyFrameType::normal, FRAME, SomfyFrame::FRAME_SIZE * CHAR_BIT);
+
+	const std::vector<SomfyFrameEvent> events = decode(buffer.get());
+	BOOST_TEST_REQUIRE(events.size() == 4);
+
+	BOOST_TEST((events[0].type == SomfyFrameEvent::Type::frameDetected));
+	BOOST_TEST((events[1].type == SomfyFrameEvent::Type::frameDecodeError));
+	BOOST_TEST(events[1].error);
+	BOOST_TEST(events[1].bitCount == 24);
+	BOOST_TEST(!events[1].frame.has_value());
+
+	// the next frame is still found
+	BOOST_TEST((events[2].type == SomfyFrameEvent::Type::frameDetected));
+	BOOST_TEST(events[2].bitCount == 0);
+	BOOST_TEST((events[3].type == SomfyFrameEvent::Type::frameDecoded));
+	BOOST_TEST(events[3].frame.has_value());
+}
+
+BOOST_AUTO_TEST_CASE(TestSomfyDecoder_interruptedByHeader)
+{
+	// a frame cut short and immediately followed by another one: the header
+	// pulses are long enough to pass for Manchester symbols
+	const SomfyFrame second(0xa8, SomfyFrame::Action::up, 0x1235, 0x56789a);
+
+	DurationBuffer buffer;
+	buffer << Duration(20ms, false);
+	SomfyFrameEncoder::appendFrame(buffer, SomfyFrameType::repeat, FRAME, 16);
+	appendFrame(buffer, SomfyFrameType::normal, second, SomfyFrame::FRAME_SIZE * CHAR_BIT);
+
+	const std::vector<SomfyFrameEvent> events = decode(buffer.get());
+	BOOST_TEST_REQUIRE(events.size() == 4);
+
+	BOOST_TEST((events[0].type == SomfyFrameEvent::Type::frameDetected));
+	BOOST_TEST((events[1].type == SomfyFrameEvent::Type::frameDecodeError));
+	BOOST_TEST(events[1].error == std::string("interrupted by a new frame header"));
+	BOOST_TEST(!events[1].frame.has_value());
+
+	BOOST_TEST((events[2].type == SomfyFrameEvent::Type::frameDetected));
+	BOOST_TEST((events[2].frameType == SomfyFrameType::normal));
+	BOOST_TEST((events[3].type == SomfyFrameEvent::Type::frameDecoded));
+	BOOST_TEST_REQUIRE(events[3].frame.has_value());
+	BOOST_TEST(events[3].frame->getRollingCode() == second.getRollingCode());
+}
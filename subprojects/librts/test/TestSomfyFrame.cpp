@@ -20,6 +20,10 @@
 
 #include <cstdint>
 #include <vector>
+#include <array>
+#include <optional>
+#include <algorithm>
+#include <stdexcept>
 #include <ostream>
 #include <iostream>
 #include <iomanip>
@@ -105,3 +109,42 @@ BOOST_AUTO_TEST_CASE(TestSomfyFrame_encode)
 
 	BOOST_TEST(data == TEST_FRAME);
 }
+
+BOOST_AUTO_TEST_CASE(TestSomfyFrame_byteArray)
+{
+	SomfyFrame::Bytes bytes;
+	std::copy(TEST_FRAME.begin(), TEST_FRAME.end(), bytes.begin());
+
+	const std::optional<SomfyFrame> frame = SomfyFrame::tryFromBytes(bytes);
+	BOOST_TEST_REQUIRE(frame.has_value());
+	BOOST_TEST(frame->getKey() == TEST_FRAME_KEY);
+	BOOST_TEST(frame->getCtrl() == TEST_FRAME_CTRL);
+	BOOST_TEST(frame->getRollingCode() == TEST_FRAME_ROLLING_CODE);
+	BOOST_TEST(frame->getAddress() == TEST_FRAME_ADDRESS);
+
+	BOOST_TEST((frame->getByteArray() == bytes));
+}
+
+BOOST_AUTO_TEST_CASE(TestSomfyFrame_wrongChecksum)
+{
+	SomfyFrame::Bytes bytes;
+	std::copy(TEST_FRAME.begin(), TEST_FRAME.end(), bytes.begin());
+	bytes.back() ^= 0x01;
+
+	BOOST_TEST(!SomfyFrame::tryFromBytes(bytes).has_value());
+
+	// the vector API throws instead
+	BOOST_CHECK_THROW(SomfyFrame::fromBytes(std::vector<uint8_t>(bytes.begin(), bytes.end())), WrongFrameChecksumException);
+	BOOST_CHECK_THROW(SomfyFrame::fromBytes(std::vector<uint8_t>(3)), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestSomfyFrame_constexpr)
+{
+	// encoding and decoding work at compile time
+	constexpr SomfyFrame FRAME(TEST_FRAME_KEY, SomfyFrame::Action::down, 0x07b3, 0x336945);
+	constexpr SomfyFrame::Bytes BYTES = FRAME.getByteArray();
+	static_assert(BYTES[0] == 0xa8 && BYTES[1] == 0xef && BYTES[6] == 0x44, "unexpected encoding");
+	static_assert(SomfyFrame::tryFromBytes(BYTES)->getRollingCode() == 0x07b3, "unexpected decoding");
+
+	BOOST_TEST(std::vector<uint8_t>(BYTES.begin(), BYTES.end()) == TEST_FRAME);
+}
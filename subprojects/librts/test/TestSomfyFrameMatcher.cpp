@@ -26,11 +26,13 @@
 #include <optional>
 #include <ostream>
 #include <functional>
+#include <cmath>
 
 #include "Clock.h"
 #include "Duration.h"
 #include "SomfyFrameType.h"
 #include "SomfyFrameMatcher.h"
+#include "SomfyFrameHeader.h"
 #include "TestUtils.h"
 
 using namespace std::literals;
@@ -184,3 +186,109 @@ BOOST_AUTO_TEST_CASE(TestSomfyFrameMatcher_noFrame)
 {
 	testMatch(NO_FRAME, 0.1, std::nullopt);
 }
+
+BOOST_AUTO_TEST_CASE(TestSomfyFrameMatcher_restartedNormal)
+{
+	// a wakeup pulse that is not followed by the rest of the header, and then a header
+	std::vector<Duration> sequence =
+	{
+		Duration(std::chrono::duration_cast<Clock::duration>(10.4ms), true),
+		Duration(std::chrono::duration_cast<Clock::duration>(7.10ms), false)
+	};
+	sequence.insert(sequence.end(), IDEAL_FRAME_HEADER_NORMAL.begin(), IDEAL_FRAME_HEADER_NORMAL.end());
+
+	SomfyFrameMatcher::FrameMatch match(
+		SomfyFrameType::normal,
+		Clock::duration::zero(),
+		false
+	);
+	testMatch(sequence, 0.1, match);
+}
+
+BOOST_AUTO_TEST_CASE(TestSomfyFrameMatcher_repeatWithExtraSync)
+{
+	// 8 HW sync pairs instead of 7
+	std::vector<Duration> sequence =
+	{
+		Duration(std::chrono::duration_cast<Clock::duration>(2.47ms), true),
+		Duration(std::chrono::duration_cast<Clock::duration>(2.55ms), false)
+	};
+	sequence.insert(sequence.end(), IDEAL_FRAME_HEADER_REPEAT.begin(), IDEAL_FRAME_HEADER_REPEAT.end());
+
+	SomfyFrameMatcher::FrameMatch match(
+		SomfyFrameType::repeat,
+		Clock::duration::zero(),
+		false
+	);
+	testMatch(sequence, 0.1, match);
+}
+
+BOOST_AUTO_TEST_CASE(TestSomfyFrameMatcher_truncatedRepeat)
+{
+	// noise and a repeat header with only 6 HW sync pairs, then a complete repeat header
+	std::vector<Duration> sequence(NO_FRAME);
+	sequence.insert(sequence.end(), IDEAL_FRAME_HEADER_REPEAT.begin() + 1, IDEAL_FRAME_HEADER_REPEAT.end());
+	testMatch(sequence, 0.1, std::nullopt);
+
+	sequence.insert(sequence.end(), IDEAL_FRAME_HEADER_REPEAT.begin(), IDEAL_FRAME_HEADER_REPEAT.end());
+	SomfyFrameMatcher::FrameMatch match(
+		SomfyFrameType::repeat,
+		Clock::duration::zero(),
+		false
+	);
+	testMatch(sequence, 0.1, match);
+}
+
+namespace
+{
+	// how the durations were compared before the windows were precomputed
+	bool referenceMatch(Clock::duration actual, Clock::duration expected, double tolerance)
+	{
+		const double a = std::chrono::duration<double>(actual).count();
+		const double e = std::chrono::duration<double>(expected).count();
+		return std::fabs(a - e) < tolerance * e;
+	}
+
+	bool referenceMatchAtLeast(Clock::duration actual, Clock::duration expected, double tolerance)
+	{
+		const double a = std::chrono::duration<double>(actual).count();
+		const double e = std::chrono::duration<double>(expected).count();
+		return a - e > - tolerance * e;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestSomfyFrameMatcher_windowBoundaries)
+{
+	const std::vector<Duration> header(SOMFY_HEADER_NORMAL.durations,
+		SOMFY_HEADER_NORMAL.durations + SOMFY_HEADER_NORMAL.count);
+
+	for (double tolerance : {0.01, 0.05, 0.1, 0.25})
+	{
+		for (size_t step = 0; step < header.size(); step++)
+		{
+			const Clock::duration expected = header[step].first;
+			const bool last = step + 1 == header.size();
+			const double delta = tolerance * expected.count();
+
+			// try a few ticks around both ends of the window
+			for (double bound : {expected.count() - delta, expected.count() + delta})
+			{
+				for (int offset = -2; offset <= 2; offset++)
+				{
+					const Clock::duration actual(std::llround(bound) + offset);
+
+					std::vector<Duration> sequence(header);
+					sequence[step].first = actual;
+
+					std::optional<SomfyFrameMatcher::FrameMatch> expectedMatch;
+					if (referenceMatch(actual, expected, tolerance))
+						expectedMatch = SomfyFrameMatcher::FrameMatch(SomfyFrameType::normal, Clock::duration::zero(), false);
+					else if (last && referenceMatchAtLeast(actual, expected, tolerance))
+						expectedMatch = SomfyFrameMatcher::FrameMatch(SomfyFrameType::normal, actual - expected, false);
+
+					testMatch(sequence, tolerance, expectedMatch);
+				}
+			}
+		}
+	}
+}
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <optional>
+#include <thread>
+#include <stdexcept>
+
+#include "ThreadedSource.h"
+
+using namespace rts;
+
+namespace
+{
+	// returns 0, 1, ..., count - 1, then std::nullopt
+	class CountingSource
+	{
+	public:
+		CountingSource(size_t count):
+			m_count(count),
+			m_next(0)
+		{}
+
+		std::optional<size_t> get()
+		{
+			if (m_next == m_count)
+				return std::nullopt;
+
+			m_lastThread = std::this_thread::get_id();
+			return m_next++;
+		}
+
+		std::thread::id getLastThread() const
+		{
+			return m_lastThread;
+		}
+
+	private:
+		const size_t m_count;
+		size_t m_next;
+		std::thread::id m_lastThread;
+	};
+
+	// returns 0, 1, ..., count - 1, then throws
+	class FailingSource
+	{
+	public:
+		FailingSource(size_t count):
+			m_source(count)
+		{}
+
+		std::optional<size_t> get()
+		{
+			std::optional<size_t> value = m_source.get();
+			if (!value)
+				throw std::runtime_error("source failed");
+
+			return value;
+		}
+
+	private:
+		CountingSource m_source;
+	};
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadedSource_passesAllValues)
+{
+	constexpr size_t COUNT = 100000;
+	CountingSource source(COUNT);
+	ThreadedSource<CountingSource, size_t> threadedSource(source, 16);
+
+	threadedSource.start();
+
+	size_t expected = 0;
+	while (std::optional<size_t> value = threadedSource.get())
+		BOOST_TEST_REQUIRE(*value == expected++);
+
+	BOOST_TEST(expected == COUNT);
+	BOOST_TEST(!threadedSource.get().has_value());
+
+	// the source has been read in another thread
+	BOOST_TEST((source.getLastThread() != std::this_thread::get_id()));
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadedSource_pinned)
+{
+	CountingSource source(10);
+	ThreadedSource<CountingSource, size_t> threadedSource(source, 4);
+
+	// CPU 0 is always there
+	threadedSource.start(0u);
+
+	size_t count = 0;
+	while (threadedSource.get())
+		count++;
+	BOOST_TEST(count == 10u);
+
+	BOOST_CHECK_THROW(threadedSource.start(), std::runtime_error);
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadedSource_destroyBeforeEnd)
+{
+	// the consumer gives up early, the thread must not be left waiting for room in the queue
+	CountingSource source(1000);
+	ThreadedSource<CountingSource, size_t> threadedSource(source, 2);
+	threadedSource.start();
+	BOOST_TEST(*threadedSource.get() == 0u);
+}
+
+BOOST_AUTO_TEST_CASE(TestThreadedSource_error)
+{
+	FailingSource source(100);
+	ThreadedSource<FailingSource, size_t> threadedSource(source, 16);
+
+	threadedSource.start();
+
+	// the values read before the error are passed on, then the error is thrown in this thread
+	size_t expected = 0;
+	BOOST_CHECK_THROW(
+		while (std::optional<size_t> value = threadedSource.get())
+			BOOST_TEST_REQUIRE(*value == expected++),
+		std::runtime_error);
+	BOOST_TEST(expected == 100u);
+}
@@ -0,0 +1,113 @@
+/*
+ * Copyright 2018 David Kozub <zub at linux.fjfi.cvut.cz>
+ *
+ * This file is part of somfy-tools.
+ *
+ * somfy-tools is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * somfy-tools is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with somfy-tools.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <cstddef>
+#include <vector>
+#include <iterator>
+#include <thread>
+#include <chrono>
+
+#include "Clock.h"
+#include "Transition.h"
+#include "backend/rpi-gpio/TransitionRing.h"
+
+using namespace rts;
+
+namespace
+{
+	Transition makeTransition(size_t i)
+	{
+		return Transition(Clock::time_point(std::chrono::microseconds(i)), i % 2 != 0);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestTransitionRing_fifo)
+{
+	TransitionRing ring(3);
+	BOOST_TEST(ring.capacity() == 3);
+	BOOST_TEST(ring.empty());
+
+	std::vector<Transition> out;
+	size_t next = 0;
+	// several rounds, so that the data wraps around the end of the buffer
+	for (size_t round = 0; round < 5; round++)
+	{
+		const size_t first = next;
+		BOOST_TEST(ring.put(makeTransition(next++)));
+		BOOST_TEST(ring.put(makeTransition(next++)));
+		BOOST_TEST(!ring.empty());
+
+		out.clear();
+		ring.drain(std::back_inserter(out));
+		BOOST_TEST(ring.empty());
+		BOOST_TEST(out.size() == 2);
+		for (size_t i = 0; i < out.size(); i++)
+			BOOST_TEST((out[i] == makeTransition(first + i)));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(TestTransitionRing_full)
+{
+	TransitionRing ring(2);
+
+	BOOST_TEST(ring.put(makeTransition(0)));
+	BOOST_TEST(ring.put(makeTransition(1)));
+	BOOST_TEST(!ring.put(makeTransition(2))); // dropped
+
+	std::vector<Transition> out;
+	ring.drain(std::back_inserter(out));
+	BOOST_TEST(out.size() == 2);
+	BOOST_TEST((out.back() == makeTransition(1)));
+
+	BOOST_TEST(ring.put(makeTransition(3)));
+}
+
+BOOST_AUTO_TEST_CASE(TestTransitionRing_twoThreads)
+{
+	constexpr size_t COUNT = 200000;
+	TransitionRing ring(7);
+
+	// the producer retries when the ring is full, the consumer when it's empty
+	std::thread producer([&ring]() {
+		for (size_t i = 0; i < COUNT; i++)
+			while (!ring.put(makeTransition(i)))
+				std::this_thread::yield();
+	});
+
+	std::vector<Transition> out;
+	out.reserve(COUNT);
+	while (out.size() < COUNT)
+	{
+		if (ring.empty())
+			std::this_thread::yield();
+		else
+			ring.drain(std::back_inserter(out));
+	}
+
+	producer.join();
+
+	bool ordered = true;
+	for (size_t i = 0; i < out.size(); i++)
+		if (out[i] != makeTransition(i))
+			ordered = false;
+
+	BOOST_TEST(ordered);
+	BOOST_TEST(out.size() == COUNT);
+}
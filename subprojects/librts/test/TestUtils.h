@@ -23,6 +23,15 @@
 
 #include <chrono>
 #include <ostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <stdexcept>
+
+#include <unistd.h>
 
 namespace std
 {
@@ -33,4 +42,41 @@ inline ostream & operator<<(ostream & os, const rts::Clock::duration & d)
 }
 }
 
+// a file name in /tmp, the file is removed when done
+class TemporaryFile
+{
+public:
+	TemporaryFile()
+	{
+		char name[] = "/tmp/rts-test-XXXXXX";
+		const int fd = mkstemp(name);
+		if (fd < 0)
+			throw std::runtime_error("can't create a temporary file");
+		close(fd);
+		m_name = name;
+	}
+
+	~TemporaryFile()
+	{
+		unlink(m_name.c_str());
+	}
+
+	TemporaryFile(const TemporaryFile &) = delete;
+	TemporaryFile & operator=(const TemporaryFile &) = delete;
+
+	const std::string & getName() const
+	{
+		return m_name;
+	}
+
+	std::vector<uint8_t> read() const
+	{
+		std::ifstream f(m_name, std::ios::binary);
+		return std::vector<uint8_t>(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+	}
+
+private:
+	std::string m_name;
+};
+
 #endif // TEST_UTILS_H